@@ -0,0 +1,27 @@
+#include <string.h>
+#include "blob_share.h"
+
+// Function to reset the buffer.
+void initBlobShare(TBlobShare *bs) {
+    memset(bs, 0, sizeof(TBlobShare));
+    initTripleBuf(&bs->slots);
+}
+
+// Function to publish a new result (writer thread only).
+void publishBlobResult(TBlobShare *bs, const TBlobSearch *blob, unsigned long seq, double t) {
+    int i = bs->slots.back;
+
+    bs->blob[i] = *blob;
+    bs->seq[i] = seq;
+    bs->t[i] = t;
+    publishTripleBuf(&bs->slots);
+}
+
+// Function to take the latest result (reader thread only).
+unsigned long readBlobResult(TBlobShare *bs, TBlobSearch *blob, double *t) {
+    int i = readTripleBuf(&bs->slots, NULL);
+
+    *blob = bs->blob[i];
+    if (t) *t = bs->t[i];
+    return bs->seq[i];
+}
@@ -0,0 +1,48 @@
+#ifndef _BLOB_SHARE_H_
+#define _BLOB_SHARE_H_
+//======================================================================
+//
+// Module that hands the latest blob search result from the camera
+// thread to the control loop without a lock, through a triple buffer
+// (see triple_buf.h).  Both sides are wait-free and neither ever sees a
+// half-written result.  There must be exactly one writer thread and one
+// reader thread.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include "detect_blob.h"
+#include "triple_buf.h"
+
+// Structure shared by the writer and the reader (initialise with initBlobShare())
+typedef struct BlobShare {
+  TBlobSearch blob[3];      // result slots
+  unsigned long seq[3];     // sequence number of the result held in each slot
+  double t[3];              // capture time of the image of each result
+  TTripleBuf slots;         // which slot the writer, the reader and the middle hold
+} TBlobShare;
+
+
+//======================================================================
+// initBlobShare():
+// Reset to an empty result (size 0) with sequence number 0.
+void initBlobShare(TBlobShare *bs);
+
+// publishBlobResult():
+// Writer side: make blob the latest result, numbered seq (increasing and
+// non-zero, e.g. the number of the camera frame it was found in) and found
+// in an image captured at time t.
+// blob->pimg is not cleared, the caller decides if it stays valid.
+void publishBlobResult(TBlobShare *bs, const TBlobSearch *blob, unsigned long seq, double t);
+
+// readBlobResult():
+// Reader side: copy the latest result into *blob, its capture time into *t
+// (unless t is NULL), and return its sequence number.  The same number is
+// returned again until a newer result arrives.
+unsigned long readBlobResult(TBlobShare *bs, TBlobSearch *blob, double *t);
+
+
+#endif /* _BLOB_SHARE_H_ */
@@ -0,0 +1,78 @@
+#include <string.h>
+#include <math.h>
+#include "blob_track.h"
+
+// Helper function for the change of halign caused by turning the car from
+// the heading of the track to the given one.
+static double turnShift(const TBlobTrack *tr, double heading) {
+    return remainder(heading - tr->heading, 2 * M_PI) * tr->halignPerRad;
+}
+
+// Function to reset a track.
+void initBlobTrack(TBlobTrack *tr, double halignPerRad) {
+    memset(tr, 0, sizeof(TBlobTrack));
+    tr->halignPerRad = halignPerRad;
+}
+
+// Helper function for one alpha-beta step of a value and its rate.
+static void filterStep(double *x, double *dx, double meas, double dt) {
+    double r = meas - (*x + *dx * dt);
+
+    *x += *dx * dt + TRACK_ALPHA * r;
+    if (dt > 0) *dx += TRACK_BETA * r / dt;
+}
+
+// Function to feed a search result.
+void updateBlobTrack(TBlobTrack *tr, const TBlobSearch *blob, double t, double heading) {
+    double h = blob->halign;
+    double dt = t - tr->t;
+
+    // move the track to the current heading; the filter only sees the blob's own motion
+    tr->halign += turnShift(tr, heading);
+    tr->heading = heading;
+
+    if (blob->size == 0) {
+        tr->misses++;
+        tr->conf *= TRACK_MISS * exp(-fmax(dt, 0) / TRACK_TAU);
+        tr->t = t;
+        // keep the position where the blob was last expected, but stop extrapolating
+        if (dt > 0 && dt < TRACK_HORIZON) {
+            tr->halign += tr->dhalign * dt;
+            tr->valign += tr->dvalign * dt;
+            tr->size = fmax(0, tr->size + tr->dsize * dt);
+        }
+        tr->dhalign = tr->dvalign = tr->dsize = 0;
+        return;
+    }
+    tr->hits++;
+    if (tr->conf < TRACK_MIN_CONF || dt <= 0 || dt > TRACK_HORIZON ||
+        fabs(h - (tr->halign + tr->dhalign * dt)) > TRACK_GATE) {
+        // new track
+        tr->restarts++;
+        tr->halign = h;
+        tr->valign = blob->valign;
+        tr->size = blob->size;
+        tr->dhalign = tr->dvalign = tr->dsize = 0;
+        tr->conf = TRACK_HIT;
+    } else {
+        filterStep(&tr->halign, &tr->dhalign, h, dt);
+        filterStep(&tr->valign, &tr->dvalign, blob->valign, dt);
+        filterStep(&tr->size, &tr->dsize, blob->size, dt);
+        if (tr->size < 0) tr->size = 0;
+        tr->conf = tr->conf * exp(-dt / TRACK_TAU);
+        tr->conf += TRACK_HIT * (1 - tr->conf);
+    }
+    tr->t = t;
+}
+
+// Function to predict the blob.
+void predictBlobTrack(const TBlobTrack *tr, double t, double heading, TBlobPredict *p) {
+    double dt = t - tr->t;
+
+    if (dt < 0) dt = 0;
+    p->conf = tr->conf * exp(-dt / TRACK_TAU);
+    if (dt > TRACK_HORIZON) dt = TRACK_HORIZON;
+    p->halign = tr->halign + tr->dhalign * dt + turnShift(tr, heading);
+    p->valign = tr->valign + tr->dvalign * dt;
+    p->size = fmax(0, tr->size + tr->dsize * dt);
+}
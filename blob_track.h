@@ -0,0 +1,93 @@
+#ifndef _BLOB_TRACK_H_
+#define _BLOB_TRACK_H_
+//======================================================================
+//
+// Module that tracks the blob over time, so the car can be steered at
+// the rate of the control loop rather than at the rate of the camera.
+// Every blob search result updates an alpha-beta filter (position and
+// rate of change) on the alignment and size of the blob; from this the
+// blob can be predicted for any later time.
+//
+// Turning the car moves the blob through the picture.  With the heading
+// of the car (e.g. from odometry.h) that part of the motion is taken out
+// of the filter and put back into the prediction, so the prediction
+// follows the car's own turns without waiting for the next picture.
+// How far and which way a turn moves the blob depends on the camera and
+// is given to initBlobTrack().
+//
+// The confidence of the track rises with every picture that shows the
+// blob and falls with every picture that does not, and with the time
+// since the last one.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include "detect_blob.h"
+
+// Filter gains for the position and the rate of change
+#define TRACK_ALPHA 0.6
+#define TRACK_BETA  0.2
+
+// Confidence: share of the missing confidence gained per picture with the
+// blob, share kept per picture without it, time constant of the decay
+// between pictures (s), and the confidence below which the track is lost
+#define TRACK_HIT  0.5
+#define TRACK_MISS 0.5
+#define TRACK_TAU  1.0
+#define TRACK_MIN_CONF 0.2
+
+// A blob further than this (in halign units) from the prediction starts a new track
+#define TRACK_GATE 0.5
+
+// Predictions are not extrapolated further than this (s)
+#define TRACK_HORIZON 1.0
+
+// Horizontal field of view of the camera (rad), and the resulting change
+// of halign per radian the car turns (for a camera that is not mirrored,
+// where a left turn moves the blob towards halign +1)
+#define TRACK_CAM_FOV 0.934
+#define TRACK_HALIGN_PER_RAD (1.0 / tan(TRACK_CAM_FOV / 2))
+
+// State of a track (initialise with initBlobTrack())
+typedef struct BlobTrack {
+  double halign, dhalign;   // horizontal alignment at the heading below and its rate (1/s)
+  double heading;           // heading of the car the alignment refers to (rad)
+  double halignPerRad;      // change of halign per radian of left turn
+  double valign, dvalign;   // vertical alignment and its rate (1/s)
+  double size, dsize;       // blob size (pixels) and its rate (pixels/s)
+  double t;                 // time of the state (s)
+  double conf;              // confidence at time t (0..1)
+  unsigned long hits, misses;  // pictures with and without the blob
+  unsigned long restarts;   // new tracks started
+} TBlobTrack;
+
+// Predicted blob
+typedef struct BlobPredict {
+  double halign, valign;    // as in TBlobSearch
+  double size;
+  double conf;              // confidence (0..1), below TRACK_MIN_CONF: blob lost
+} TBlobPredict;
+
+
+//======================================================================
+// initBlobTrack():
+// Start without a track (confidence 0).  halignPerRad is the change of
+// halign when the car turns left by one radian: TRACK_HALIGN_PER_RAD, or
+// its negative for a mirrored picture.
+void initBlobTrack(TBlobTrack *tr, double halignPerRad);
+
+// updateBlobTrack():
+// Feed the search result of a picture taken at time t (seconds, any clock
+// used consistently) while the car had the given heading (rad, positive to
+// the left; pass 0 without odometry).  blob->size == 0 counts as a miss.
+void updateBlobTrack(TBlobTrack *tr, const TBlobSearch *blob, double t, double heading);
+
+// predictBlobTrack():
+// Predict the blob at time t for a car with the given heading.
+void predictBlobTrack(const TBlobTrack *tr, double t, double heading, TBlobPredict *p);
+
+
+#endif /* _BLOB_TRACK_H_ */
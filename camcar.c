@@ -1,100 +1,190 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <initio.h>
-#include <curses.h>
 #include <unistd.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <pwd.h>
-#include <pthread.h>
 #include <assert.h>
 #include "detect_blob.h"
+#include "camera_stream.h"
+#include "pipeline.h"
+#include "blob_share.h"
+#include "periodic.h"
+#include "motor_sched.h"
+#include "frame_trace.h"
+#include "event_log.h"
+#include "ui.h"
+#include "sensors.h"
+#include "odometry.h"
+#include "blob_track.h"
 
 // Constants defining the minimum and maximum distance (in cm) for maintaining proper distance
 #define DIST_MIN 60
 #define DIST_MAX 100
 
+// Which way a left turn of the car moves the blob in the picture (+1: towards
+// halign +1).  The car turns right towards a blob at halign < 0, so its
+// picture is mirrored; the simulator's is not (see Makefile).  The car's
+// value is inferred from that rule, not measured: check it before using -s.
+#ifndef CAM_HALIGN_TURN
+#define CAM_HALIGN_TURN -1
+#endif
+
+// Largest camera frame the pipeline decodes (CAMERA_STREAM_CMD delivers 200x200)
+#define CAM_MAX_W 640
+#define CAM_MAX_H 480
+
+// Control loop timing: default period (overridden with -p), SCHED_FIFO
+// priorities and CPUs of the control thread and the camera pipeline threads
+#define CTRL_PERIOD_US 20000
+#define CTRL_PRIO 50
+#define CTRL_CPUS (1UL << 3)
+#define CAM_PRIO 40
+#define CAM_CPUS ((1UL << 0) | (1UL << 1) | (1UL << 2))
+
+// Sensor sampling rates (Hz, 0: not sampled) and priority of the sampling
+// thread (below the control loop, on its CPU).  The line sensors are unused
+// and the wheel sensors belong to the odometry (see odometry.h).  IR readings
+// older than SENSOR_STALE_MS and distances older than SENSOR_US_STALE_MS are
+// not trusted; the distance is the median of SENSOR_US_MEDIAN samples.
+#define SENSOR_RATE_IR 500
+#define SENSOR_RATE_LINE 0
+#define SENSOR_RATE_US 25
+#define SENSOR_RATE_WHEEL 0
+#define SENSOR_PRIO 45
+#define SENSOR_STALE_MS 50
+#define SENSOR_US_STALE_MS 200
+#define SENSOR_US_MEDIAN 3
+
 // Structure used for communication between the main thread and the camera thread
 struct thread_dat {
-    TBlobSearch blob;  // Holds the blob object detected by the camera
-    int blobnr;        // Tracks the blob number, indicating when a new image is produced
-    int bExit;         // Flag used to signal thread termination
+    TBlobShare blobs;  // Latest blob detected by the camera, numbered per processed image
+    TPipeline *pipe;   // Capture / decode / detect pipeline producing the blobs
+    TPeriodic period;  // Fixed-rate timing of the control loop
+    int rtFlags;       // Real-time setup that succeeded (RT_* of periodic.h)
+    TMotorSched *motor;  // Timed motor commands, run without blocking the control loop
+    TUi *ui;           // Display and keyboard, NULL when running headless (-n)
+    TSensors *sensors; // Background sampling of the IR and ultrasonic sensors
+    int odoMode;       // Source of the wheel odometry edges (ODO_*), 0 if none
+    int steerTrack;    // Steer every cycle from the tracker prediction, which then
+                       // follows the car's turns (-s, needs odometry)
 };
 
-// Mutex for protecting shared data between threads
-pthread_mutex_t count_mutex;
+// Set by SIGINT / SIGTERM to end a headless run
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onStopSignal(int sig)
+{
+    stopRequested = 1;
+}
+
+// Returns non-zero when the user asked to end the program
+int quitRequested(struct thread_dat *ptdat)
+{
+    return stopRequested || (ptdat->ui && uiQuit(ptdat->ui));
+}
 
 // Main function implementing the hierarchical finite state machines (FSMs) for car control
 void camcar(int argc, char *argv[], struct thread_dat *ptdat) 
 {
-    int ch = 0;  // Variable to store user input key
-    int blobnr = 0;  // Tracks the blob number processed in the last cycle
+    unsigned long blobnr = 0;  // Tracks the blob number processed in the last cycle
+    unsigned long newnr;  // Number of the latest blob produced by the camera
+    unsigned long tracednr = 0;  // Last blob number stamped in the frame trace
+    int state = EV_STATE_NONE;  // FSM state of the last cycle (EV_STATE_*), for the event log
     TBlobSearch blob;  // Blob object for processing
+    double blobTime;  // Capture time of the image the blob was found in
+    TBlobTrack track;  // Blob tracked over the images, predicted between them
+    TCarStatus status = {0};  // Snapshot for the display
+
+    // Only -s lets the car's turns move the track: CAM_HALIGN_TURN is not
+    // measured on the car, and with the wrong sign they would push the
+    // prediction away from the blob.  Otherwise the heading has no effect.
+    initBlobTrack(&track, ptdat->steerTrack && ptdat->odoMode ? CAM_HALIGN_TURN * TRACK_HALIGN_PER_RAD : 0);
 
-    // Main control loop
-    while (ch != 'q') {
+    // Main control loop, one iteration per period
+    while (!quitRequested(ptdat)) {
         int obstacle_L, obstacle_R, obstacle;  // Variables for obstacle detection
         int blobSufficient;  // Indicates whether the detected blob is of sufficient size
         int carBlobAligned;  // Indicates whether the car is aligned with the blob
-        int distance;  // Variable to store the distance to an object
+        int distance = -1;  // Variable to store the distance to an object (-1: no reading)
+        TSensorSample irL, irR, us;  // Latest sensor readings
+        TOdometry odo;  // Wheel speeds and dead-reckoned pose
+        TBlobPredict pred;  // Blob predicted for this cycle
+        double now;
+        int newState;  // FSM state reached in this cycle
         enum { distok, tooclose, toofar } distanceState;  // FSM states for maintaining distance
 
-        // Display program instructions
-        mvprintw(1, 1, "%s: Press 'q' to end program", argv[0]);
+        waitPeriod(&ptdat->period);  // Sleep until the next period starts
 
-        // Acquire blob data from the camera thread with mutex protection
-        pthread_mutex_lock(&count_mutex);
-        blob = ptdat->blob;
-        pthread_mutex_unlock(&count_mutex);
+        // Acquire the latest blob data from the camera pipeline (never blocks)
+        newnr = readBlobResult(&ptdat->blobs, &blob, &blobTime);
+        now = monoTime();
+        getOdometry(&odo);
+        if (newnr != tracednr) {
+            traceFrame(newnr, TRACE_CONSUME);
+            logEvent(EV_BLOB, 0, blob.size, (int)newnr, blob.halign);
+            // the car has turned on since the image was taken
+            updateBlobTrack(&track, &blob, blobTime, odo.heading - odo.turnRate * (now - blobTime));
+        }
+
+        // Where the blob is now, as far as the images and the car's own turns tell
+        predictBlobTrack(&track, now, odo.heading, &pred);
 
-        // Display the current blob data
-        mvprintw(10, 1, "Status: blob(size=%d, halign=%f, blobnr=%u)", blob.size, blob.halign, ptdat->blobnr);
+        // Images taken while a pulse is running do not count as new:
+        // the next pulse waits for an image taken after the car stopped
+        if (motorBusy(ptdat->motor)) blobnr = newnr;
 
-        // Read obstacle sensors
-        obstacle_L = (initio_IrLeft() != 0);
-        obstacle_R = (initio_IrRight() != 0);
+        // Read obstacle sensors; a missing or stale reading counts as an obstacle
+        obstacle_L = !sensorLatest(ptdat->sensors, SENSOR_IR_LEFT, &irL) ||
+                     irL.value || sensorAge(&irL) > SENSOR_STALE_MS;
+        obstacle_R = !sensorLatest(ptdat->sensors, SENSOR_IR_RIGHT, &irR) ||
+                     irR.value || sensorAge(&irR) > SENSOR_STALE_MS;
         obstacle = obstacle_L || obstacle_R;
 
+        // Distance to the object in front, filtered against spurious echoes;
+        // stays -1 while there is no recent reading
+        if (sensorMedian(ptdat->sensors, SENSOR_ULTRASONIC, SENSOR_US_MEDIAN, &us) &&
+            sensorAge(&us) <= SENSOR_US_STALE_MS) distance = us.value;
+
         // FSM for obstacle avoidance
         if (obstacle) {
-            mvprintw(3, 1, "State OA (stop to avoid obstacle), o-left=%d, o-right=%d", obstacle_L, obstacle_R);
-            clrtoeol();  // Clear to end of line
-            initio_DriveForward(0);  // Stop the car
+            newState = EV_STATE_OA;
+            motorStop(ptdat->motor);  // Stop the car, cutting any running pulse short
         } else {
-            refresh();  // Update display
-
-            blobSufficient = (blob.size > 20);  // Check if the blob size is above the threshold
+            // Check if the tracked blob is still trusted and of sufficient size
+            blobSufficient = (pred.conf >= TRACK_MIN_CONF && pred.size > 20);
 
             // FSM for searching a blob
             if (!blobSufficient) {
-                mvprintw(3, 1, "State SB (search blob), blob.size=%d (blobnr: %u)", blob.size, ptdat->blobnr);
-                clrtoeol();
-                if (blobnr < ptdat->blobnr) {
+                newState = EV_STATE_SB;
+                if (blobnr < newnr) {
                     // Turn the car slightly to search for a blob
-                    initio_SpinLeft(50);
-                    delay(200);
-                    initio_DriveForward(0);
-                    blobnr = ptdat->blobnr;
+                    motorPulse(ptdat->motor, MOTOR_SPIN_LEFT, 50, 200);
+                    blobnr = newnr;
                 }
             } else {
-                carBlobAligned = (blob.halign >= -0.25 && blob.halign <= 0.25);  // Check alignment with blob
+                carBlobAligned = (pred.halign >= -0.25 && pred.halign <= 0.25);  // Check alignment with blob
 
                 // FSM for aligning to a blob
                 if (!carBlobAligned) {
-                    mvprintw(3, 1, "State AB (align towards blob), blob.size=%d, halign=%f", blob.size, blob.halign);
-                    clrtoeol();
-                    if (blobnr < ptdat->blobnr) {
-                        if (blob.halign < 0) {
-                            initio_SpinRight(40);
-                            delay(150);
+                    newState = EV_STATE_AB;
+                    if (ptdat->steerTrack && ptdat->odoMode) {
+                        // the prediction follows the car's turn: steer every cycle until aligned
+                        motorPulse(ptdat->motor, (pred.halign < 0) == (CAM_HALIGN_TURN > 0) ? MOTOR_SPIN_LEFT : MOTOR_SPIN_RIGHT, 40, 0);
+                    } else if (blobnr < newnr) {
+                        if ((pred.halign < 0) != (CAM_HALIGN_TURN > 0)) {
+                            motorPulse(ptdat->motor, MOTOR_SPIN_RIGHT, 40, 150);
                         } else {
-                            initio_SpinLeft(40);
-                            delay(150);
+                            motorPulse(ptdat->motor, MOTOR_SPIN_LEFT, 40, 150);
                         }
-                        initio_DriveForward(0);
-                        blobnr = ptdat->blobnr;
+                        blobnr = newnr;
                     }
                 } else {
-                    distance = initio_UsGetDistance();  // Get distance from ultrasonic sensor
-                    if (distance < DIST_MIN) {
+                    if (distance < 0) {
+                        distanceState = distok;  // no distance: hold rather than back off blindly
+                    } else if (distance < DIST_MIN) {
                         distanceState = tooclose;
                     } else if (distance > DIST_MAX) {
                         distanceState = toofar;
@@ -105,78 +195,197 @@ void camcar(int argc, char *argv[], struct thread_dat *ptdat)
                     // FSM for maintaining proper blob distance
                     switch (distanceState) {
                         case toofar:
-                            mvprintw(3, 1, "State FB (drive forward), dist=%d", distance);
-                            clrtoeol();
-                            initio_DriveForward(40);  // Move forward slowly
+                            newState = EV_STATE_FB;
+                            motorPulse(ptdat->motor, MOTOR_FORWARD, 40, 0);  // Move forward slowly
                             break;
                         case tooclose:
-                            mvprintw(3, 1, "State RB (drive backwards), dist=%d", distance);
-                            clrtoeol();
-                            initio_DriveReverse(40);  // Move backward slowly
+                            newState = EV_STATE_RB;
+                            motorPulse(ptdat->motor, MOTOR_REVERSE, 40, 0);  // Move backward slowly
                             break;
                         case distok:
-                            mvprintw(3, 1, "State KD (keep distance), dist=%d", distance);
-                            clrtoeol();
-                            initio_DriveForward(0);  // Maintain current position
+                            newState = EV_STATE_KD;
+                            motorStop(ptdat->motor);  // Maintain current position
                             break;
                     }
                 }
             }
         }
 
-        // Handle user input for quitting
-        ch = getch();
-        if (ch != ERR) mvprintw(2, 1, "Key code: '%c' (%d)", ch, ch);
-        refresh();  // Update display
+        // Log the sensor readings and state changes of this cycle
+        getOdometry(&odo);
+        logEvent(EV_SENSOR, obstacle_L | (obstacle_R << 1), distance, (int)(odo.heading * 1000), odo.speed);
+        if (newState != state) {
+            logEvent(EV_STATE, newState, state, 0, 0);
+            state = newState;
+        }
+
+        // The decision on a new blob, and its motor command, is complete
+        if (newnr != tracednr) {
+            traceFrame(newnr, TRACE_ACTUATE);
+            tracednr = newnr;
+        }
+
+        // Hand the status to the display thread (never blocks)
+        if (ptdat->ui) {
+            status.state = state;
+            status.obstacleL = obstacle_L;
+            status.obstacleR = obstacle_R;
+            status.distance = distance;
+            status.blobSize = blob.size;
+            status.halign = blob.halign;
+            status.blobnr = newnr;
+            status.trackHalign = pred.halign;
+            status.trackConf = pred.conf;
+            status.period = ptdat->period.period;
+            status.rtFlags = ptdat->rtFlags;
+            getPeriodicStats(&ptdat->period, &status.timing);
+            status.odo = odo;
+            status.odoMode = ptdat->odoMode;
+            publishUiStatus(ptdat->ui, &status);
+        }
     }
 }
 
-// Thread function to continuously process camera images and detect blobs
-void *worker(void *p_thread_dat) 
+// Callback of the detect stage, called for every processed camera image
+void publishBlob(void *p_thread_dat, const TBlobSearch *blob, unsigned long seq, double t)
 {
     struct thread_dat *ptdat = (struct thread_dat *) p_thread_dat;
-    const char blobColor[3] = {255, 0, 0};  // Target blob color (red)
-    TBlobSearch blob;
 
-    while (ptdat->bExit == 0) {
-        blob = cameraSearchBlob(blobColor);  // Detect red-colored blobs
+    TBlobSearch res = *blob;
 
-        // Copy detected blob data to shared structure with mutex protection
-        pthread_mutex_lock(&count_mutex);
-        ptdat->blob = blob;
-        ptdat->blobnr++;
-        pthread_mutex_unlock(&count_mutex);
-    }
-    return NULL;
+    res.pimg = NULL;  // the frame goes back to the pool after the callback
+    publishBlobResult(&ptdat->blobs, &res, seq, t);
 }
 
 // Main function to initialize resources and start the threads
 int main(int argc, char *argv[]) 
 {
-    WINDOW *mainwin = initscr();  // Initialize curses library
-    noecho();
-    cbreak();
-    nodelay(mainwin, TRUE);
-    keypad(mainwin, TRUE);
+    long period_us = CTRL_PERIOD_US;
+    const char *traceFile = NULL;  // Chrome trace of the frame latencies, written at exit
+    const char *logFile = NULL;  // Binary event log (decode with tools/evlogdump)
+    int headless = 0;  // Run without display, end with Ctrl-C
+    int pollWheels = 0;  // Poll the wheel sensors instead of using interrupts
+    int steerTrack = 0;  // Steer continuously from the tracker prediction
+    int opt;
+
+    // Usage: camcar [-n] [-w] [-s] [-p period_ms] [-t trace.json] [-l events.bin] [recorded.mjpeg]
+    while ((opt = getopt(argc, argv, "nwsp:t:l:")) != -1) {
+        if (opt == 'p' && atof(optarg) > 0) {
+            period_us = (long)(atof(optarg) * 1000);
+        } else if (opt == 't') {
+            traceFile = optarg;
+        } else if (opt == 'l') {
+            logFile = optarg;
+        } else if (opt == 'n') {
+            headless = 1;
+        } else if (opt == 'w') {
+            pollWheels = 1;
+        } else if (opt == 's') {
+            steerTrack = 1;
+        } else {
+            fprintf(stderr, "usage: %s [-n] [-w] [-s] [-p period_ms] [-t trace.json] [-l events.bin] [recorded.mjpeg]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    enableFrameTrace(traceFile != NULL);
+    if (logFile && openEventLog(logFile)) {
+        fprintf(stderr, "%s: cannot create %s\n", argv[0], logFile);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, onStopSignal);
+    signal(SIGTERM, onStopSignal);
 
     initio_Init();  // Initialize robot control library
-    pthread_mutex_init(&count_mutex, NULL);  // Initialize mutex
 
-    pthread_t cam_thread;  // Thread handle for camera processing
-    pthread_attr_t pt_attr;  // Thread attributes
+    const char blobColor[3] = {255, 0, 0};  // Target blob color (red)
+    TCamStream *cs;  // Long-lived frame source, started once
     struct thread_dat tdat = {0};  // Shared data structure
+    initBlobShare(&tdat.blobs);
+
+    // Wheel odometry is not needed for the control, so carry on without it
+    tdat.odoMode = startOdometry(pollWheels ? ODO_POLLED : ODO_ISR);
+    if (tdat.odoMode == 0) fprintf(stderr, "%s: cannot start wheel odometry\n", argv[0]);
+    tdat.steerTrack = steerTrack;
 
-    pthread_attr_init(&pt_attr);  // Initialize thread attributes
-    pthread_create(&cam_thread, &pt_attr, worker, (void*)&tdat);  // Create worker thread
+    // Optional recorded MJPEG stream instead of the camera
+    if (optind < argc) {
+        cs = openCameraStreamFile(argv[optind]);
+    } else {
+        cs = openCameraStream(CAMERA_STREAM_CMD);
+    }
+    if (cs) tdat.pipe = startPipeline(cs, blobColor, CAM_MAX_W, CAM_MAX_H, publishBlob, &tdat);
+    if (tdat.pipe == NULL) {
+        fprintf(stderr, "%s: cannot start camera pipeline\n", argv[0]);
+        closeCameraStream(cs);
+        initio_Cleanup();
+        return EXIT_FAILURE;
+    }
+
+    // Sensor sampling threads, started at normal priority (see setSensorsRealtime())
+    const int sensorRates[SENSOR_CHANNELS] = {
+        SENSOR_RATE_IR, SENSOR_RATE_IR, SENSOR_RATE_LINE, SENSOR_RATE_LINE,
+        SENSOR_RATE_US, SENSOR_RATE_WHEEL, SENSOR_RATE_WHEEL
+    };
+    tdat.sensors = startSensors(sensorRates);
+    if (tdat.sensors == NULL) {
+        fprintf(stderr, "%s: cannot start sensor sampling\n", argv[0]);
+        stopPipeline(tdat.pipe);
+        closeCameraStream(cs);
+        initio_Cleanup();
+        return EXIT_FAILURE;
+    }
+
+    // Real-time setup; whatever is not permitted is skipped (degraded mode)
+    tdat.rtFlags = lockMemory();
+    tdat.rtFlags |= setThreadRealtime(pthread_self(), CTRL_PRIO, CTRL_CPUS);
+    setPipelineRealtime(tdat.pipe, CAM_PRIO, CAM_CPUS);
+    setSensorsRealtime(tdat.sensors, SENSOR_PRIO, CTRL_CPUS);
+    initPeriodic(&tdat.period, period_us);
+    tdat.motor = startMotorSched();  // inherits the control thread's priority and CPU
+    if (tdat.motor == NULL) {
+        stopSensors(tdat.sensors);
+        stopPipeline(tdat.pipe);
+        closeCameraStream(cs);
+        initio_Cleanup();
+        fprintf(stderr, "%s: cannot start motor scheduler\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Display on the camera CPUs at normal priority, away from the control loop
+    if (!headless) {
+        tdat.ui = startUi(argv[0], tdat.pipe, CAM_CPUS);
+        if (tdat.ui == NULL) fprintf(stderr, "%s: cannot start the display, running headless (end with Ctrl-C)\n", argv[0]);
+    }
 
     camcar(argc, argv, &tdat);  // Start main control loop
 
-    tdat.bExit = 1;  // Signal worker thread to exit
-    pthread_join(cam_thread, NULL);  // Wait for worker thread to finish
-    pthread_attr_destroy(&pt_attr);  // Destroy thread attributes
+    if (tdat.ui) stopUi(tdat.ui);  // Stop the display and restore the terminal
+    stopMotorSched(tdat.motor);  // Stop the motors and the scheduler thread
+    stopSensors(tdat.sensors);  // Stop the sampling threads
+    stopPipeline(tdat.pipe);  // Stop and join the pipeline threads
+    closeCameraStream(cs);
 
-    pthread_mutex_destroy(&count_mutex);  // Destroy mutex
+    stopOdometry();
     initio_Cleanup();  // Cleanup robot resources
-    endwin();  // Cleanup curses library
+    closeEventLog();  // Flush the event log
+
+    TPeriodicStats st;
+    getPeriodicStats(&tdat.period, &st);
+    if (st.cycles > 0) {
+        printf("control loop: %lu cycles, %lu missed deadlines, wake-up latency max %lld us, exec avg %lld us, max %lld us\n",
+               st.cycles, st.missed, st.latMax / 1000, st.execSum / st.cycles / 1000, st.execMax / 1000);
+    }
+    if (tdat.odoMode) {
+        TOdometry odo;
+        getOdometry(&odo);
+        printf("odometry (%s): %lu/%lu wheel edges, %.2f m driven, pose x %.2f m, y %.2f m, heading %.0f deg\n",
+               tdat.odoMode == ODO_ISR ? "interrupts" : "polled", odo.ticksL, odo.ticksR, odo.distance,
+               odo.x, odo.y, odo.heading * 180 / M_PI);
+    }
+    if (traceFile) {
+        printFrameTraceSummary(stdout);
+        if (writeFrameTrace(traceFile)) fprintf(stderr, "%s: cannot write %s\n", argv[0], traceFile);
+    }
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "camera_stream.h"
+
+// Initial size of the stream buffer; it grows if a frame does not fit.
+#define STREAM_BUF_SIZE (256 * 1024)
+
+// Smallest free space requested from read().
+#define STREAM_READ_MIN (16 * 1024)
+
+// Structure for one open frame source.
+struct CamStream {
+    int fd;                 // Read end of the pipe, file or FIFO.
+    pid_t pid;              // Child process, 0 if reading a file.
+    unsigned char *buf;     // Bytes read but not yet handed out.
+    size_t size;            // Capacity of buf.
+    size_t head;            // Start of unconsumed data in buf.
+    size_t tail;            // End of valid data in buf.
+    int eof;                // No more data will arrive.
+    unsigned long frames;   // Number of frames delivered.
+};
+
+// Result codes of findFrame().
+#define FRAME_FOUND   1
+#define FRAME_PARTIAL 0
+#define FRAME_CORRUPT -1
+
+// Helper function to locate one complete JPEG image in p[0..n).
+// Markers are walked segment by segment, so an EOI inside an embedded
+// thumbnail or inside entropy-coded data does not end the frame early.
+// On FRAME_FOUND the image is p[*start..*end); *start is always set to the
+// first SOI seen (or to where the search may resume if there is none).
+static int findFrame(const unsigned char *p, size_t n, size_t *start, size_t *end) {
+    size_t i = 0, seglen;
+    unsigned char m;
+
+    while (i + 1 < n && !(p[i] == 0xFF && p[i + 1] == 0xD8)) i++;
+    *start = i;
+    if (i + 1 >= n) return FRAME_PARTIAL;
+    i += 2;
+
+    while (1) {
+        if (i + 1 >= n) return FRAME_PARTIAL;
+        if (p[i] != 0xFF) return FRAME_CORRUPT;
+        m = p[i + 1];
+        if (m == 0xFF) {                          // fill byte
+            i++;
+            continue;
+        }
+        if (m == 0xD9) {                          // EOI
+            *end = i + 2;
+            return FRAME_FOUND;
+        }
+        if (m == 0xD8) return FRAME_CORRUPT;      // SOI of the next image
+        if (m == 0x01 || (m >= 0xD0 && m <= 0xD7)) {
+            i += 2;                               // markers without payload
+            continue;
+        }
+        if (i + 3 >= n) return FRAME_PARTIAL;
+        seglen = (p[i + 2] << 8) | p[i + 3];
+        if (seglen < 2) return FRAME_CORRUPT;
+        i += 2 + seglen;
+        if (m == 0xDA) {
+            // entropy-coded data runs until a marker other than FF00 / RSTn
+            while (i + 1 < n) {
+                if (p[i] != 0xFF) {
+                    i++;
+                } else if (p[i + 1] == 0x00 || (p[i + 1] >= 0xD0 && p[i + 1] <= 0xD7)) {
+                    i += 2;
+                } else if (p[i + 1] == 0xFF) {
+                    i++;
+                } else {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Helper function to read more bytes into the buffer, compacting or growing it first.
+// Returns the number of bytes read, 0 at the end of the stream.
+static ssize_t fillBuffer(TCamStream *cs) {
+    ssize_t n;
+    unsigned char *nbuf;
+
+    if (cs->head > 0) {
+        memmove(cs->buf, cs->buf + cs->head, cs->tail - cs->head);
+        cs->tail -= cs->head;
+        cs->head = 0;
+    }
+    if (cs->size - cs->tail < STREAM_READ_MIN) {
+        nbuf = (unsigned char *)realloc(cs->buf, cs->size * 2);
+        if (nbuf == NULL) return 0;
+        cs->buf = nbuf;
+        cs->size *= 2;
+    }
+    do {
+        n = read(cs->fd, cs->buf + cs->tail, cs->size - cs->tail);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        cs->eof = 1;
+        return 0;
+    }
+    cs->tail += n;
+    return n;
+}
+
+// Helper function to set up a stream around an open descriptor.
+static TCamStream *newStream(int fd, pid_t pid) {
+    TCamStream *cs = (TCamStream *)calloc(1, sizeof(TCamStream));
+
+    if (cs == NULL) return NULL;
+    cs->buf = (unsigned char *)malloc(STREAM_BUF_SIZE);
+    if (cs->buf == NULL) {
+        free(cs);
+        return NULL;
+    }
+    cs->size = STREAM_BUF_SIZE;
+    cs->fd = fd;
+    cs->pid = pid;
+    return cs;
+}
+
+// Function to start a streaming child process and read from its stdout.
+TCamStream *openCameraStream(const char *cmd) {
+    int fds[2];
+    pid_t pid;
+    TCamStream *cs;
+    char *shcmd;
+
+    // "exec" makes the command itself the child, so closeCameraStream() can stop it
+    shcmd = (char *)malloc(strlen(cmd) + 6);
+    if (shcmd == NULL) return NULL;
+    strcpy(shcmd, "exec ");
+    strcat(shcmd, cmd);
+
+    if (pipe(fds)) {
+        free(shcmd);
+        return NULL;
+    }
+    pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        free(shcmd);
+        return NULL;
+    }
+    if (pid == 0) {
+        // child: stdout into the pipe, then become the streaming command
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execl("/bin/sh", "sh", "-c", shcmd, (char *)NULL);
+        _exit(127);
+    }
+    free(shcmd);
+    close(fds[1]);
+    cs = newStream(fds[0], pid);
+    if (cs == NULL) {
+        close(fds[0]);
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+    return cs;
+}
+
+// Function to read a recorded MJPEG stream from a file or FIFO.
+TCamStream *openCameraStreamFile(const char *fname) {
+    int fd = open(fname, O_RDONLY);
+    TCamStream *cs;
+
+    if (fd < 0) return NULL;
+    cs = newStream(fd, 0);
+    if (cs == NULL) close(fd);
+    return cs;
+}
+
+// Function to return the next complete JPEG image of the stream.
+int nextCameraFrame(TCamStream *cs, const unsigned char **jpeg, size_t *len) {
+    size_t start, end;
+    int res;
+
+    while (1) {
+        res = findFrame(cs->buf + cs->head, cs->tail - cs->head, &start, &end);
+        if (res == FRAME_FOUND) {
+            *jpeg = cs->buf + cs->head + start;
+            *len = end - start;
+            cs->head += end;
+            cs->frames++;
+            return 1;
+        }
+        if (res == FRAME_CORRUPT) {
+            // drop the broken image and resynchronise on the next SOI
+            cs->head += start + 2;
+            continue;
+        }
+        // keep a partial frame, but no garbage in front of it
+        cs->head += start;
+        if (cs->eof || fillBuffer(cs) == 0) return 0;
+    }
+}
+
+// Function to return the number of frames delivered so far.
+unsigned long cameraStreamFrames(TCamStream *cs) {
+    return cs->frames;
+}
+
+// Function to stop the stream and release its resources.
+void closeCameraStream(TCamStream *cs) {
+    if (cs == NULL) return;
+    close(cs->fd);
+    if (cs->pid > 0) {
+        kill(cs->pid, SIGTERM);
+        waitpid(cs->pid, NULL, 0);
+    }
+    free(cs->buf);
+    free(cs);
+}
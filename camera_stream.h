@@ -0,0 +1,56 @@
+#ifndef _CAMERA_STREAM_H_
+#define _CAMERA_STREAM_H_
+//======================================================================
+//
+// Module that provides a persistent MJPEG frame source for the Raspberry
+// PI camera.  Instead of starting raspistill for every picture, one
+// long-lived process (or a recorded file, or a FIFO) delivers a
+// continuous stream of concatenated JPEG images, which is split into
+// frames along the JPEG markers.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include <stddef.h>
+
+// Command streaming MJPEG from the camera to stdout (same picture
+// settings as the still capture in detect_blob.c).  The simulator build
+// replaces it with a reader of the simulated camera (see sim/).
+#ifndef CAMERA_STREAM_CMD
+#define CAMERA_STREAM_CMD "raspivid -w 200 -h 200 -t 0 -fps 30 -cd MJPEG -awb fluorescent --nopreview -rot 270 -o -"
+#endif
+
+// Handle of an open frame source
+typedef struct CamStream TCamStream;
+
+
+//======================================================================
+// openCameraStream():
+// Start cmd (e.g. CAMERA_STREAM_CMD) as a child process and read MJPEG
+// from its standard output.  Returns NULL on failure.
+TCamStream *openCameraStream(const char *cmd);
+
+// openCameraStreamFile():
+// Read MJPEG from a file or FIFO, e.g. a recorded .mjpeg stream.
+// Returns NULL on failure.
+TCamStream *openCameraStreamFile(const char *fname);
+
+// nextCameraFrame():
+// Block until the next complete JPEG image is available and return it in
+// *jpeg / *len.  Returns 1 for a frame and 0 at the end of the stream.
+// Mem: The frame stays valid until the next call on the same stream.
+int nextCameraFrame(TCamStream *cs, const unsigned char **jpeg, size_t *len);
+
+// cameraStreamFrames():
+// Number of frames delivered so far.
+unsigned long cameraStreamFrames(TCamStream *cs);
+
+// closeCameraStream():
+// Stop the child process (if any) and free the stream.
+void closeCameraStream(TCamStream *cs);
+
+
+#endif /* _CAMERA_STREAM_H_ */
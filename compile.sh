@@ -8,4 +8,16 @@
 gcc -c -I./resource -o camcar.o      camcar.c
 gcc -c -I./resource -o detect_blob.o detect_blob.c
 gcc -c -I./resource -o quickblob.o   quickblob.c
+gcc -c -I./resource -o camera_stream.o camera_stream.c
 
+gcc -c -I./resource -o pipeline.o      pipeline.c
+gcc -c -I./resource -o triple_buf.o    triple_buf.c
+gcc -c -I./resource -o blob_share.o    blob_share.c
+gcc -c -I./resource -o periodic.o      periodic.c
+gcc -c -I./resource -o motor_sched.o   motor_sched.c
+gcc -c -I./resource -o frame_trace.o   frame_trace.c
+gcc -c -I./resource -o event_log.o     event_log.c
+gcc -c -I./resource -o ui.o            ui.c
+gcc -c -I./resource -o sensors.o       sensors.c
+gcc -c -I./resource -o odometry.o      odometry.c
+gcc -c -I./resource -o blob_track.o    blob_track.c
@@ -5,6 +5,8 @@
 #include <jerror.h>
 #include <assert.h>
 #include <string.h>
+#include <math.h>
+#include <pthread.h>
 #include "detect_blob.h"
 #include "quickblob.h"
 
@@ -12,18 +14,55 @@
 #define max(a,b)  ({ __typeof__ (a) _a = (a); __typeof__ (b) _b = (b); _a > _b ? _a : _b; })
 #define min(a,b)  ({ __typeof__ (a) _a = (a); __typeof__ (b) _b = (b); _a < _b ? _a : _b; })
 
+// Lookup tables that turn an RGB pixel into a color class (0 = no match, i+1 = color i).
+typedef struct ColorClassifier {
+  int rule;               // BLOB_RULE_BOX or BLOB_RULE_HSV.
+  int numColors;          // Number of reference colors the tables were built for.
+  unsigned char ref[BLOB_MAX_COLORS][3];  // Reference colors the tables were built for.
+  unsigned char chanMask[3][256];  // Box rule: bit i set if the channel value matches color i.
+  unsigned char firstClass[256];   // Box rule: class of the lowest bit set in a mask.
+  unsigned char cube[32 * 32 * 32];  // HSV rule: class of each 8x8x8 RGB cell.
+} TColorClassifier;
+
 // Structure for managing image and blob search operations.
 typedef struct QuickBlob {
   TJImage *pimg;          // Pointer to image data.
-  char ref[3];            // RGB reference values for blob filtering.
+  int numColors;          // Number of reference colors in use.
+  unsigned char ref[BLOB_MAX_COLORS][3];  // RGB reference values for blob filtering.
   int frame;              // Frame counter (not used in single-image applications).
-  double ref_rel[3];      // Normalized reference values relative to red component.
-  struct blob blob_max;   // Largest detected blob.
+  int topK;               // Number of blobs kept per color.
+  int numTop[BLOB_MAX_COLORS];  // Number of valid entries in blob_top per color.
+  struct blob blob_top[BLOB_MAX_COLORS][BLOB_MAX_TOPK];  // Largest blobs per color, by size.
+  struct jpeg_decompress_struct *jinfo;  // Decoder feeding the rows in streaming mode.
+  unsigned char *line;    // One decoded RGB scanline in streaming mode.
+  const TColorClassifier *cls;  // Classifier for ref[], shared by all rows.
+  int minSize;            // Smaller blobs are pruned (decoded pixels).
+  int stopSize;           // A blob this large ends the search, 0 = never (decoded pixels).
+  int pyramid;            // Coarse pass: one pixel of every pyramid x pyramid box is labelled, or 1.
 } TQuickBlob;
 
+// Pool of equally sized frames, handed out with reference counts.
+struct JFramePool {
+  int numFrames;
+  TJImage *frames;          // All frames of the pool.
+  TJImage **free;           // Stack of frames with no references.
+  int numFree;
+  pthread_mutex_t lock;     // Protects the free stack.
+};
+
+// Alignment of pooled image buffers (cache line / SIMD friendly).
+#define FRAME_ALIGN 64
+
 // Macro to check if a pixel matches a reference color within a range.
 #define BLOB_MATCH(ref,dat) (((ref)*0.9 <= (dat)) && ((dat) <= min(255,(ref)*1.1)))
 
+// Tolerances of the HSV rule.
+#define HSV_HUE_TOL   20.0  // max. hue distance in degrees
+#define HSV_SAT_MIN   0.35  // min. saturation of a pixel matching a chromatic color
+#define HSV_VAL_MIN   0.15  // min. value of a pixel matching a chromatic color
+#define HSV_GRAY_SAT  0.20  // colors below this saturation are treated as gray levels
+#define HSV_GRAY_TOL  0.15  // max. value distance for gray levels
+
 // Command to capture an image using the Raspberry Pi camera.
 #define CAMERA_CMD "raspistill -w 200 -h 200 -t 1 -awb fluorescent --nopreview --mode 7 -rot 270"
 
@@ -33,6 +72,16 @@ int init_pixel_stream_hook(void* user_struct, struct stream_state* stream);
 int close_pixel_stream_hook(void* user_struct, struct stream_state* stream);
 int next_row_hook(void* user_struct, struct stream_state* stream);
 int next_frame_hook(void* user_struct, struct stream_state* stream);
+static int prune_blob_hook(void* user_struct, struct blob* b);
+static int jpeg_init_pixel_stream_hook(void* user_struct, struct stream_state* stream);
+static int jpeg_next_row_hook(void* user_struct, struct stream_state* stream);
+
+// Helper function returning the calling thread's extractor.
+static struct extractor *blobExtractor(int w);
+
+// Helper function behind the jpeg*SearchBlobs() functions.
+static int jpegSearch(FILE *file, const unsigned char *buf, unsigned long len,
+                      const char colors[][3], int num_colors, int top_k, TBlobSearch results[]);
 
 // Helper function to merge multiple strings into one dynamically allocated string.
 static char* MergeStrings(int num_args, char* str1, ...);
@@ -41,77 +90,859 @@ static char* MergeStrings(int num_args, char* str1, ...);
 void bailout(char *msg);
 
 // Function to capture an image and search for the largest blob matching a specific color.
+// A serial search is fused with the JPEG decoder; a parallel one needs the decoded frame.
 TBlobSearch cameraSearchBlob(const char color[3]) {
     TJImage img;
-    img = capturePhoto();
-    return imageSearchBlob(color, &img);
+    TBlobSearch blob_res;
+    FILE *fp;
+    char *cmd;
+
+    if (blobExtractor(0)->pool) {
+        img = capturePhoto();
+        return imageSearchBlob(color, &img);
+    }
+
+    cmd = MergeStrings(2, CAMERA_CMD, " -o - ");
+    fp = popen(cmd, "r");
+    if (fp == NULL) bailout("cameraSearchBlob() failed!");
+
+    blob_res = jpegSearchBlob(fp, color);
+
+    pclose(fp);
+    free(cmd);
+    return blob_res;
+}
+
+// Hook table handed to the QuickBlob extractor.
+static const struct quickblob_hooks blob_hooks = {
+    log_blob_hook,
+    init_pixel_stream_hook,
+    close_pixel_stream_hook,
+    next_row_hook,
+    next_frame_hook,
+    prune_blob_hook
+};
+
+// One extractor per thread, so concurrent searches never share buffers
+// and repeated searches do not allocate.
+static __thread struct extractor blob_extractor;
+static __thread int blob_extractor_ready = 0;
+
+// Hook table and extractor for searches fused with the JPEG decoder.
+// Rows arrive strictly in order, so this extractor always runs serially.
+static const struct quickblob_hooks jpeg_blob_hooks = {
+    log_blob_hook,
+    jpeg_init_pixel_stream_hook,
+    close_pixel_stream_hook,
+    jpeg_next_row_hook,
+    next_frame_hook,
+    prune_blob_hook
+};
+static __thread struct extractor jpeg_extractor;
+static __thread int jpeg_extractor_ready = 0;
+static __thread unsigned char *jpeg_line = NULL;  // Scanline buffer, grows to the widest frame.
+static __thread int jpeg_line_size = 0;
+
+// Color classifier of the calling thread, rebuilt only when colors or rule change.
+static __thread TColorClassifier color_classifier;
+static __thread int color_rule = BLOB_RULE_BOX;
+
+// JPEG decode options of the calling thread (see setJpegDecodeScale()).
+static __thread int decode_scale = 1;
+static __thread int decode_fast = 0;
+
+// Search windows and pruning of the calling thread (full-frame pixels).
+static __thread TBlobRoi search_roi[BLOB_MAX_ROI];
+static __thread int search_roi_n = 0;
+static __thread int search_min_size = 0;
+static __thread int search_stop_size = 0;
+static __thread long search_pixels = 0;
+static __thread int search_pyramid = 1;  // Coarse pass factor (see setBlobSearchPyramid()).
+static __thread int search_engine = BLOB_ENGINE_LISTS;
+static __thread int search_connectivity = 4;
+static __thread int search_packed = 0;  // Packed rows for single-color searches (see setBlobSearchPacked()).
+
+// Helper function returning the calling thread's extractor, creating it on first use.
+static struct extractor *blobExtractor(int w) {
+    if (!blob_extractor_ready) {
+        if (extractor_init(&blob_extractor, &blob_hooks, w)) bailout("blobExtractor: out of memory");
+        blob_extractor_ready = 1;
+    }
+    return &blob_extractor;
+}
+
+// Function to set the number of threads used by blob searches of the calling thread.
+void setBlobSearchThreads(int threads) {
+    if (extractor_set_threads(blobExtractor(0), threads)) bailout("setBlobSearchThreads: cannot start threads");
+}
+
+// Function to set the labelling engine and connectivity of the blob searches of the calling thread.
+void setBlobSearchEngine(int engine, int connectivity) {
+    if (engine != BLOB_ENGINE_LISTS && engine != BLOB_ENGINE_UNION_FIND) bailout("setBlobSearchEngine: unknown engine");
+    if (connectivity != 4 && connectivity != 8) bailout("setBlobSearchEngine: connectivity must be 4 or 8");
+    search_engine = engine;
+    search_connectivity = connectivity;
+}
+
+// Function to release the search state of the calling thread.
+void freeBlobSearch(void) {
+    if (blob_extractor_ready) {
+        extractor_free(&blob_extractor);
+        blob_extractor_ready = 0;
+    }
+    if (jpeg_extractor_ready) {
+        extractor_free(&jpeg_extractor);
+        jpeg_extractor_ready = 0;
+    }
+    free(jpeg_line);
+    jpeg_line = NULL;
+    jpeg_line_size = 0;
+}
+
+// Function to restrict the image searches of the calling thread to a few windows.
+int setBlobSearchRoi(const TBlobRoi rois[], int num_rois) {
+    if (num_rois < 0 || num_rois > BLOB_MAX_ROI) return -1;
+    if (num_rois > 0) memcpy(search_roi, rois, num_rois * sizeof(TBlobRoi));
+    search_roi_n = num_rois;
+    return 0;
+}
+
+// Function to compute a search window around a found blob.
+TBlobRoi blobSearchRoi(const TBlobSearch *blob, double grow, int pad) {
+    const struct blob *b = &blob->blob;
+    int dx = (int)(grow * (b->bb_x2 - b->bb_x1 + 1)) + pad;
+    int dy = (int)(grow * (b->bb_y2 - b->bb_y1 + 1)) + pad;
+    TBlobRoi roi;
+
+    roi.x1 = b->bb_x1 - dx;
+    roi.y1 = b->bb_y1 - dy;
+    roi.x2 = b->bb_x2 + dx;
+    roi.y2 = b->bb_y2 + dy;
+    return roi;
+}
+
+// Helper function telling if a blob found in a w x h image touches an edge of
+// roi inside the image, where it may have been cut off (full-frame pixels).
+static int blobAtRoiEdge(const TBlobSearch *blob, const TBlobRoi *roi, int w, int h) {
+    const struct blob *b = &blob->blob;
+
+    return (roi->x1 > 0 && b->bb_x1 <= roi->x1) || (roi->x2 < w - 1 && b->bb_x2 >= roi->x2) ||
+           (roi->y1 > 0 && b->bb_y1 <= roi->y1) || (roi->y2 < h - 1 && b->bb_y2 >= roi->y2);
+}
+
+// Helper function to get the full-frame size of an image decoded at 1/scale.
+static void frameSize(const TJImage *pimg, int *fw, int *fh) {
+    int scale = max(pimg->scale, 1);
+
+    *fw = pimg->fullW > 0 ? pimg->fullW : pimg->w * scale;
+    *fh = pimg->fullH > 0 ? pimg->fullH : pimg->h * scale;
+}
+
+// Function to search for a blob through a window around where it was last seen.
+TBlobSearch followSearchBlob(TBlobFollow *f, const char color[3], TJImage *pimg) {
+    TBlobRoi saved[BLOB_MAX_ROI];
+    int savedN = search_roi_n;
+    int fw, fh;
+    long pixels = 0;
+    TBlobSearch blob;
+
+    frameSize(pimg, &fw, &fh);
+    memcpy(saved, search_roi, sizeof(saved));
+    f->searches++;
+    if (f->windowed > 0) {
+        search_roi[0] = f->roi;
+        search_roi_n = 1;
+        blob = imageSearchBlob(color, pimg);
+        pixels = search_pixels;
+        if (pixels >= (long)pimg->w * pimg->h) {
+            f->full++;  // nothing in the window, the search fell back
+        } else if (blob.size > 0 && blobAtRoiEdge(&blob, &f->roi, fw, fh)) {
+            f->windowed = 0;
+        }
+    }
+    if (f->windowed == 0) {
+        search_roi_n = 0;
+        blob = imageSearchBlob(color, pimg);
+        pixels += search_pixels;
+        f->full++;
+    }
+    memcpy(search_roi, saved, sizeof(saved));
+    search_roi_n = savedN;
+    search_pixels = pixels;
+
+    if (blob.size > 0 && ++f->windowed < BLOB_FOLLOW_FULL) {
+        f->roi = blobSearchRoi(&blob, BLOB_FOLLOW_GROW, BLOB_FOLLOW_PAD);
+    } else {
+        f->windowed = 0;
+    }
+    return blob;
+}
+
+// Function to set whether single-color searches of the calling thread use packed rows.
+void setBlobSearchPacked(int packed) {
+    search_packed = packed != 0;
+}
+
+// Function to set which blobs the searches of the calling thread ignore or stop at.
+void setBlobSearchPrune(int min_size, int stop_size) {
+    search_min_size = max(min_size, 0);
+    search_stop_size = max(stop_size, 0);
+}
+
+// Function to set the coarse-to-fine search of the calling thread.
+void setBlobSearchPyramid(int factor) {
+    if (factor != 1 && factor != 2 && factor != 4) bailout("setBlobSearchPyramid: factor must be 1, 2 or 4");
+    search_pyramid = factor;
+}
+
+// Function to return the number of pixels scanned by the last search of the calling thread.
+long getBlobSearchPixels(void) {
+    return search_pixels;
+}
+
+// Function to set how the calling thread decodes JPEG images.
+void setJpegDecodeScale(int scale, int fast) {
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8) bailout("setJpegDecodeScale: scale must be 1, 2, 4 or 8");
+    decode_scale = scale;
+    decode_fast = fast;
+}
+
+// Helper function to apply the decode options between jpeg_read_header() and jpeg_start_decompress().
+static void setDecodeOptions(struct jpeg_decompress_struct *info) {
+    info->scale_num = 1;
+    info->scale_denom = decode_scale;
+    if (decode_fast) {
+        info->dct_method = JDCT_IFAST;
+        info->do_fancy_upsampling = FALSE;
+    }
+}
+
+// Helper function to fill in a search result from a finished blob of an image
+// decoded at 1/scale of a fw x fh full frame.  Blob coordinates, size and sums
+// are mapped back to the full frame, a decoded pixel covering scale x scale
+// pixels (the decoder rounds the decoded size up, the last block may stick out).
+static void setBlobSearch(TBlobSearch *res, struct blob *b, int fw, int fh, int scale, TJImage *pimg) {
+    long long n = b->size, s = scale;
+    long long a = s * (s - 1) / 2;                // sum of the offsets 0..s-1 in a block
+    long long q = (s - 1) * s * (2 * s - 1) / 6;  // sum of their squares
+
+    res->blob = *b;
+    res->halign = 0.0;
+    res->valign = 0.0;
+    if (scale > 1 && b->size > 0) {
+        res->blob.size = b->size * scale * scale;
+        res->blob.center_x = (b->center_x + 0.5) * scale - 0.5;
+        res->blob.center_y = (b->center_y + 0.5) * scale - 0.5;
+        res->blob.bb_x1 = b->bb_x1 * scale;
+        res->blob.bb_y1 = b->bb_y1 * scale;
+        res->blob.bb_x2 = min(b->bb_x2 * scale + scale - 1, fw - 1);
+        res->blob.bb_y2 = min(b->bb_y2 * scale + scale - 1, fh - 1);
+        res->blob.sum_x = s * s * s * b->sum_x + s * a * n;
+        res->blob.sum_y = s * s * s * b->sum_y + s * a * n;
+        res->blob.sum_xx = s * s * s * s * b->sum_xx + 2 * s * s * a * b->sum_x + s * q * n;
+        res->blob.sum_yy = s * s * s * s * b->sum_yy + 2 * s * s * a * b->sum_y + s * q * n;
+        res->blob.sum_xy = s * s * s * s * b->sum_xy + s * s * a * (b->sum_x + b->sum_y) + a * a * n;
+        res->blob.major_axis = b->major_axis * scale;
+        res->blob.minor_axis = b->minor_axis * scale;
+    }
+    res->size = res->blob.size;
+    if (b->size > 0) {
+        // Calculate alignment of the blob relative to the center of the full frame.
+        res->halign = -1.0 + 2.0 * ((double)(res->blob.center_x) / fw);
+        res->valign = -1.0 + 2.0 * ((double)(res->blob.center_y) / fh);
+    }
+    res->pimg = pimg;
+}
+
+// Function to select the color matching rule of the calling thread.
+void setBlobColorRule(int rule) {
+    if (rule != BLOB_RULE_BOX && rule != BLOB_RULE_HSV) bailout("setBlobColorRule: unknown rule");
+    color_rule = rule;
+}
+
+// Helper function to convert RGB (0..255) to hue (degrees), saturation and value (0..1).
+static void rgbToHsv(double r, double g, double b, double *h, double *s, double *v) {
+    double mx = max(r, max(g, b));
+    double mn = min(r, min(g, b));
+    double d = mx - mn;
+
+    *v = mx / 255.0;
+    *s = mx > 0 ? d / mx : 0.0;
+    if (d <= 0) {
+        *h = 0.0;
+    } else if (mx == r) {
+        *h = 60.0 * fmod((g - b) / d + 6.0, 6.0);
+    } else if (mx == g) {
+        *h = 60.0 * ((b - r) / d + 2.0);
+    } else {
+        *h = 60.0 * ((r - g) / d + 4.0);
+    }
+}
+
+// Helper function implementing the HSV rule for one pixel and one reference color.
+static int hsvMatch(const unsigned char ref[3], double r, double g, double b) {
+    double rh, rs, rv, h, s, v, dh;
+
+    rgbToHsv(ref[0], ref[1], ref[2], &rh, &rs, &rv);
+    rgbToHsv(r, g, b, &h, &s, &v);
+    if (rs < HSV_GRAY_SAT) {
+        return s < HSV_GRAY_SAT && fabs(v - rv) <= HSV_GRAY_TOL;
+    }
+    dh = fabs(h - rh);
+    if (dh > 180.0) dh = 360.0 - dh;
+    return s >= HSV_SAT_MIN && v >= HSV_VAL_MIN && dh <= HSV_HUE_TOL;
+}
+
+// Helper function returning the classifier for the colors of dblob, building it if needed.
+// The box rule is separable, so per-channel match masks reproduce BLOB_MATCH exactly.
+static const TColorClassifier *getClassifier(TQuickBlob *dblob) {
+    TColorClassifier *cls = &color_classifier;
+    int i, c, v, m, r, g, b;
+
+    if (cls->numColors == dblob->numColors && cls->rule == color_rule &&
+        memcmp(cls->ref, dblob->ref, dblob->numColors * 3) == 0) {
+        return cls;
+    }
+
+    cls->rule = color_rule;
+    cls->numColors = dblob->numColors;
+    memcpy(cls->ref, dblob->ref, dblob->numColors * 3);
+
+    if (cls->rule == BLOB_RULE_BOX) {
+        for (c = 0; c < 3; c++) {
+            for (v = 0; v < 256; v++) {
+                cls->chanMask[c][v] = 0;
+                for (i = 0; i < cls->numColors; i++) {
+                    if (BLOB_MATCH(cls->ref[i][c], v)) cls->chanMask[c][v] |= 1 << i;
+                }
+            }
+        }
+        cls->firstClass[0] = 0;
+        for (m = 1; m < 256; m++) {
+            cls->firstClass[m] = __builtin_ctz(m) + 1;
+        }
+    } else {
+        // classify the center of each cell
+        for (r = 0; r < 32; r++) {
+            for (g = 0; g < 32; g++) {
+                for (b = 0; b < 32; b++) {
+                    m = 0;
+                    for (i = 0; i < cls->numColors && !m; i++) {
+                        if (hsvMatch(cls->ref[i], r * 8 + 4, g * 8 + 4, b * 8 + 4)) m = i + 1;
+                    }
+                    cls->cube[(r << 10) | (g << 5) | b] = m;
+                }
+            }
+        }
+    }
+    return cls;
+}
+
+// Helper function to prepare the QuickBlob interface for a multi-color search.
+static int initQuickBlob(TQuickBlob *dblob, const char colors[][3], int num_colors, int top_k) {
+    int i;
+
+    if (num_colors < 1 || num_colors > BLOB_MAX_COLORS || top_k < 1 || top_k > BLOB_MAX_TOPK) return -1;
+
+    dblob->pimg = NULL;
+    dblob->jinfo = NULL;
+    dblob->line = NULL;
+    dblob->pyramid = 1;
+    dblob->numColors = num_colors;
+    dblob->topK = top_k;
+    for (i = 0; i < num_colors; i++) {
+        dblob->ref[i][0] = colors[i][0];
+        dblob->ref[i][1] = colors[i][1];
+        dblob->ref[i][2] = colors[i][2];
+    }
+    dblob->cls = getClassifier(dblob);
+    return 0;
+}
+
+// Helper function to convert the prune sizes of the calling thread to an image
+// decoded at 1/scale (a decoded pixel covers scale x scale full-frame pixels).
+static void setQuickBlobPrune(TQuickBlob *dblob, int scale) {
+    int area = scale * scale;
+
+    dblob->minSize = (search_min_size + area - 1) / area;
+    dblob->stopSize = 0;
+    if (search_stop_size > 0 && dblob->numColors == 1 && dblob->topK == 1) {
+        dblob->stopSize = max((search_stop_size + area - 1) / area, 1);
+    }
+}
+
+// Helper function to copy the per-color top-k lists into the caller's result array.
+static void getQuickBlobResults(TQuickBlob *dblob, int fw, int fh, int scale, TJImage *pimg, TBlobSearch results[]) {
+    int i, k;
+
+    for (i = 0; i < dblob->numColors; i++) {
+        for (k = 0; k < dblob->topK; k++) {
+            TBlobSearch *res = &results[i * dblob->topK + k];
+            if (k < dblob->numTop[i]) {
+                setBlobSearch(res, &dblob->blob_top[i][k], fw, fh, scale, pimg);
+            } else {
+                memset(res, 0, sizeof(TBlobSearch));
+                res->pimg = pimg;
+            }
+        }
+    }
+}
+
+// Helper function to set up ex for the search of dblob: the engine of the calling
+// thread, and packed rows when there is a single color (classes 0 and 1 only).
+static void setQuickBlobInput(struct extractor *ex, const TQuickBlob *dblob) {
+    extractor_set_engine(ex, search_engine, search_connectivity);
+    extractor_set_input(ex, search_packed && dblob->numColors == 1 ? QUICKBLOB_BITS : QUICKBLOB_BYTES);
+}
+
+// Helper function to label w pixels by color class (0 = no match, i+1 = first matching color i).
+static void classifyRow(TQuickBlob *dblob, const unsigned char *pix, int numChannels, unsigned char *row, int w) {
+    const TColorClassifier *cls = dblob->cls;
+    int x;
+
+    if (cls->rule == BLOB_RULE_BOX) {
+        for (x = 0; x < w; x++, pix += numChannels) {
+            row[x] = cls->firstClass[cls->chanMask[0][pix[0]] & cls->chanMask[1][pix[1]] & cls->chanMask[2][pix[2]]];
+        }
+    } else {
+        for (x = 0; x < w; x++, pix += numChannels) {
+            row[x] = cls->cube[((pix[0] >> 3) << 10) | ((pix[1] >> 3) << 5) | (pix[2] >> 3)];
+        }
+    }
+}
+
+// Helper function to label w pixels of a single-color search straight into a
+// packed mask, bit x of bits[] set for a match.  With one color the box rule's
+// channel masks are 0 or 1 already, so no class lookup is needed.
+static void classifyRowBits(TQuickBlob *dblob, const unsigned char *pix, int numChannels, uint64_t *bits, int w) {
+    const TColorClassifier *cls = dblob->cls;
+    uint64_t word;
+    int x, i, n;
+
+    for (x = 0; x < w; x += 64) {
+        n = min(w - x, 64);
+        word = 0;
+        if (cls->rule == BLOB_RULE_BOX) {
+            for (i = 0; i < n; i++, pix += numChannels) {
+                word |= (uint64_t)(cls->chanMask[0][pix[0]] & cls->chanMask[1][pix[1]] & cls->chanMask[2][pix[2]]) << i;
+            }
+        } else {
+            for (i = 0; i < n; i++, pix += numChannels) {
+                word |= (uint64_t)cls->cube[((pix[0] >> 3) << 10) | ((pix[1] >> 3) << 5) | (pix[2] >> 3)] << i;
+            }
+        }
+        bits[x >> 6] = word;
+    }
+}
+
+// Helper function to label a row into whichever buffer the stream asks for.
+static void labelRow(TQuickBlob *dblob, const unsigned char *pix, int numChannels, struct stream_state *stream) {
+    if (stream->packed) {
+        classifyRowBits(dblob, pix, numChannels, stream->bits, stream->w);
+    } else {
+        classifyRow(dblob, pix, numChannels, stream->row, stream->w);
+    }
+}
+
+// Helper function for the coarse pass of a pyramid search for the blobs of
+// fine, run on ex.  Fills rois with windows (decoded pixels) that reach one
+// box beyond the candidates found and returns their number, 0 if the whole
+// image has to be searched (no candidate, or more than BLOB_MAX_ROI), or -1
+// if the coarse pass failed (out of memory).  Each
+// color gets one candidate more than it reports, in case the coarse sizes
+// rank blobs of similar size differently.
+static int pyramidWindows(struct extractor *ex, const TQuickBlob *fine, struct roi rois[], long *pixels) {
+    TQuickBlob coarse = *fine;
+    int f = search_pyramid;
+    int i, k, n = 0;
+    struct blob *b;
+
+    coarse.pyramid = f;
+    coarse.topK = min(fine->topK + 1, BLOB_MAX_TOPK);
+    coarse.minSize = fine->minSize / (f * f);
+    coarse.stopSize = 0;
+    extractor_set_rois(ex, NULL, 0, 0);
+    if (extractor_run(ex, (void*)&coarse)) return -1;
+    *pixels = (long)ex->pixels;
+
+    for (i = 0; i < coarse.numColors; i++) {
+        for (k = 0; k < coarse.numTop[i]; k++) {
+            if (n == BLOB_MAX_ROI) return 0;
+            b = &coarse.blob_top[i][k];
+            rois[n].x1 = (b->bb_x1 - 1) * f;
+            rois[n].y1 = (b->bb_y1 - 1) * f;
+            rois[n].x2 = (b->bb_x2 + 2) * f - 1;
+            rois[n].y2 = (b->bb_y2 + 2) * f - 1;
+            n++;
+        }
+    }
+    return n;
 }
 
 // Function to search an image for the largest blob of a specific color.
 TBlobSearch imageSearchBlob(const char color[3], TJImage *pimg) {
     TBlobSearch blob_res;  // Structure to store the search result.
+    const char colors[1][3] = { { color[0], color[1], color[2] } };
+
+    imageSearchBlobs(colors, 1, 1, pimg, &blob_res);
+    return blob_res;
+}
+
+// Function to search an image for the largest blobs of several colors in one pass.
+int imageSearchBlobs(const char colors[][3], int num_colors, int top_k, TJImage *pimg, TBlobSearch results[]) {
     TQuickBlob dblob;      // Structure for interfacing with QuickBlob.
+    struct extractor *ex = blobExtractor(pimg->w);
+    struct roi rois[BLOB_MAX_ROI];
+    int scale = max(pimg->scale, 1);
+    int i, n = search_roi_n, fw, fh;
+    long pixels = 0;
 
+    if (initQuickBlob(&dblob, colors, num_colors, top_k)) return -1;
     dblob.pimg = pimg;
-    dblob.ref[0] = color[0];
-    dblob.ref[1] = color[1];
-    dblob.ref[2] = color[2];
+    setQuickBlobPrune(&dblob, scale);
+    setQuickBlobInput(ex, &dblob);
 
-    extract_image((void*)&dblob); // Search blobs in the image using QuickBlob.
+    if (n > 0) {
+        // windows are given in full-frame pixels
+        for (i = 0; i < n; i++) {
+            rois[i].x1 = search_roi[i].x1 / scale;
+            rois[i].y1 = search_roi[i].y1 / scale;
+            rois[i].x2 = search_roi[i].x2 / scale;
+            rois[i].y2 = search_roi[i].y2 / scale;
+        }
+    } else if (search_pyramid > 1) {
+        n = pyramidWindows(ex, &dblob, rois, &pixels);
+    }
+    if (n >= 0) {
+        extractor_set_rois(ex, rois, n, 1);
+        if (extractor_run(ex, (void*)&dblob)) n = -1; // Search blobs in the image using QuickBlob.
+        pixels += (long)ex->pixels;
+    }
+    search_pixels = pixels;
 
-    blob_res.blob = dblob.blob_max;
-    blob_res.size = dblob.blob_max.size;
+    frameSize(pimg, &fw, &fh);
+    getQuickBlobResults(&dblob, fw, fh, scale, pimg, results);
+    return n < 0 ? -1 : 0;
+}
+
+// Function to decode a JPEG stream and search it for the largest blob of a specific color.
+TBlobSearch jpegSearchBlob(FILE *file, const char color[3]) {
+    TBlobSearch blob_res;
+    const char colors[1][3] = { { color[0], color[1], color[2] } };
+
+    jpegSearchBlobs(file, colors, 1, 1, &blob_res);
+    return blob_res;
+}
 
-    if (dblob.blob_max.size > 0) {
-        // Calculate alignment of the blob relative to the center of the image.
-        blob_res.halign = -1.0 + 2.0 * ((double)(dblob.blob_max.center_x) / (dblob.pimg)->w);
-        blob_res.valign = -1.0 + 2.0 * ((double)(dblob.blob_max.center_y) / (dblob.pimg)->h);
+// Helper function to read a JPEG from file, or from the len bytes at buf if file is NULL.
+static void setJpegSource(struct jpeg_decompress_struct *info, FILE *file, const unsigned char *buf, unsigned long len) {
+    if (file) {
+        jpeg_stdio_src(info, file);
+    } else {
+        jpeg_mem_src(info, (unsigned char *)buf, len);
     }
+}
+
+// Function to decode a JPEG stream and search it for blobs while it is decoded.
+int jpegSearchBlobs(FILE *file, const char colors[][3], int num_colors, int top_k, TBlobSearch results[]) {
+    return jpegSearch(file, NULL, 0, colors, num_colors, top_k, results);
+}
 
-    blob_res.pimg = pimg;
+// Function to decode a JPEG held in memory and search it for the largest blob of a specific color.
+TBlobSearch jpegMemSearchBlob(const unsigned char *buf, unsigned long len, const char color[3]) {
+    TBlobSearch blob_res;
+    const char colors[1][3] = { { color[0], color[1], color[2] } };
+
+    jpegSearch(NULL, buf, len, colors, 1, 1, &blob_res);
     return blob_res;
 }
 
-// Function to read JPEG image data using libjpeg.
-TJImage read_JPEG_image(FILE *file) {
-    struct jpeg_decompress_struct info; // JPEG decompression structure.
-    struct jpeg_error_mgr err;          // Error handler for JPEG library.
-    static unsigned char *img_data = NULL; // Buffer to hold image data.
+// Function to decode a JPEG held in memory and search it for blobs while it is decoded.
+int jpegMemSearchBlobs(const unsigned char *buf, unsigned long len, const char colors[][3], int num_colors, int top_k, TBlobSearch results[]) {
+    return jpegSearch(NULL, buf, len, colors, num_colors, top_k, results);
+}
 
-    TJImage img;
+// Helper function behind the jpeg*SearchBlobs() functions.
+static int jpegSearch(FILE *file, const unsigned char *buf, unsigned long len,
+                      const char colors[][3], int num_colors, int top_k, TBlobSearch results[]) {
+    struct jpeg_decompress_struct info;
+    struct jpeg_error_mgr err;
+    TQuickBlob dblob;
+    int status;
+
+    if (initQuickBlob(&dblob, colors, num_colors, top_k)) return -1;
 
     info.err = jpeg_std_error(&err);
     jpeg_create_decompress(&info);
-    jpeg_stdio_src(&info, file);
+    setJpegSource(&info, file, buf, len);
     jpeg_read_header(&info, TRUE);
+    info.out_color_space = JCS_RGB;  // labelRow() expects three channels
+    setDecodeOptions(&info);
     jpeg_start_decompress(&info);
 
-    img.w = info.output_width;
-    img.h = info.output_height;
-    img.numChannels = info.num_components; // Number of color channels (e.g., RGB or RGBA).
+    // Only a single scanline is ever held; it is reused across frames.
+    if (jpeg_line_size < (int)info.output_width * 3) {
+        jpeg_line_size = info.output_width * 3;
+        jpeg_line = (unsigned char *)realloc(jpeg_line, jpeg_line_size);
+        if (jpeg_line == NULL) bailout("jpegSearchBlobs: out of memory");
+    }
+    if (!jpeg_extractor_ready) {
+        if (extractor_init(&jpeg_extractor, &jpeg_blob_hooks, info.output_width)) bailout("jpegSearchBlobs: out of memory");
+        jpeg_extractor_ready = 1;
+    }
+    dblob.jinfo = &info;
+    dblob.line = jpeg_line;
+    setQuickBlobPrune(&dblob, decode_scale);
+    setQuickBlobInput(&jpeg_extractor, &dblob);
 
-    unsigned long dataSize = img.w * img.h * img.numChannels;
+    status = extractor_run(&jpeg_extractor, (void*)&dblob);
+    search_pixels = (long)jpeg_extractor.pixels;
 
-    // Allocate or resize the image data buffer.
-    if (img_data == NULL) {
-        img_data = (unsigned char *)malloc(dataSize);
+    if (info.output_scanline < info.output_height) {
+        jpeg_abort_decompress(&info);
     } else {
-        img_data = (unsigned char *)realloc(img_data, dataSize);
+        jpeg_finish_decompress(&info);
     }
+    getQuickBlobResults(&dblob, info.image_width, info.image_height, decode_scale, NULL, results);
+    jpeg_destroy_decompress(&info);
+    return status ? -1 : 0;
+}
 
-    img.data = img_data;
+// Hook: keeps the top-k largest blobs of each color class (class 0 is background).
+void log_blob_hook(void* user_struct, struct blob* b) {
+    TQuickBlob *dblob = (TQuickBlob *) user_struct;
+    int c = b->color - 1;
+    int k;
 
-    // Read each scanline into the image buffer.
+    if (c < 0 || c >= dblob->numColors) return;
+    k = dblob->numTop[c];
+    if (k == dblob->topK) {
+        if (b->size <= dblob->blob_top[c][k - 1].size) return;
+        k--;
+    } else {
+        dblob->numTop[c]++;
+    }
+    // insertion step, keeping the list ordered by decreasing size
+    while (k > 0 && dblob->blob_top[c][k - 1].size < b->size) {
+        dblob->blob_top[c][k] = dblob->blob_top[c][k - 1];
+        k--;
+    }
+    dblob->blob_top[c][k] = *b;
+}
+
+// Hook: drops background and blobs below the minimum size, and ends the
+// search at the first blob of the stop size.
+static int prune_blob_hook(void* user_struct, struct blob* b) {
+    TQuickBlob *dblob = (TQuickBlob *) user_struct;
+
+    if (b->color < 1 || b->color > dblob->numColors || b->size < dblob->minSize) return QUICKBLOB_DROP;
+    if (dblob->stopSize > 0 && b->size >= dblob->stopSize) return QUICKBLOB_STOP;
+    return QUICKBLOB_KEEP;
+}
+
+// Hook: announces the image dimensions to QuickBlob.
+int init_pixel_stream_hook(void* user_struct, struct stream_state* stream) {
+    TQuickBlob *dblob = (TQuickBlob *) user_struct;
+    int f = dblob->pyramid;
+    stream->w = (dblob->pimg->w + f - 1) / f;
+    stream->h = (dblob->pimg->h + f - 1) / f;
+    dblob->frame = 0;
+    memset(dblob->numTop, 0, sizeof(dblob->numTop));
+    return 0;
+}
+
+// Hook: nothing to release, the image belongs to the caller.
+int close_pixel_stream_hook(void* user_struct, struct stream_state* stream) {
+    return 0;
+}
+
+// Hook: labels row stream->y of the image by color class, from column stream->x0 on.
+int next_row_hook(void* user_struct, struct stream_state* stream) {
+    TQuickBlob *dblob = (TQuickBlob *) user_struct;
+    TJImage *pimg = dblob->pimg;
+
+    if (dblob->pyramid > 1) {
+        // top left pixel of each box in the coarse pass
+        labelRow(dblob, &JImageDATA(pimg, stream->x0 * dblob->pyramid, stream->y * dblob->pyramid, 0),
+                 pimg->numChannels * dblob->pyramid, stream);
+        return 0;
+    }
+
+    labelRow(dblob, &JImageDATA(pimg, stream->x0, stream->y, 0), pimg->numChannels, stream);
+    return 0;
+}
+
+// Hook: announces the dimensions of the JPEG being decoded.
+static int jpeg_init_pixel_stream_hook(void* user_struct, struct stream_state* stream) {
+    TQuickBlob *dblob = (TQuickBlob *) user_struct;
+    stream->w = dblob->jinfo->output_width;
+    stream->h = dblob->jinfo->output_height;
+    dblob->frame = 0;
+    memset(dblob->numTop, 0, sizeof(dblob->numTop));
+    return 0;
+}
+
+// Hook: decodes the next scanline and labels it while it is still in cache.
+static int jpeg_next_row_hook(void* user_struct, struct stream_state* stream) {
+    TQuickBlob *dblob = (TQuickBlob *) user_struct;
+    JSAMPROW rowptr = dblob->line;
+
+    if (jpeg_read_scanlines(dblob->jinfo, &rowptr, 1) != 1) return 1;
+    labelRow(dblob, dblob->line, 3, stream);
+    return 0;
+}
+
+// Hook: a still image is a single frame.
+int next_frame_hook(void* user_struct, struct stream_state* stream) {
+    TQuickBlob *dblob = (TQuickBlob *) user_struct;
+    return dblob->frame++ > 0;
+}
+
+// Helper function to decode a JPEG (file, or len bytes at buf) into pimg->data, which holds
+// *capacity bytes.  With grow set the buffer is reallocated when it is too small, otherwise
+// -1 is returned.
+static int decodeJpeg(FILE *file, const unsigned char *buf, unsigned long len,
+                      TJImage *pimg, unsigned long *capacity, int grow) {
+    struct jpeg_decompress_struct info; // JPEG decompression structure.
+    struct jpeg_error_mgr err;          // Error handler for JPEG library.
+    unsigned long dataSize;
     unsigned char* rowptr;
-    while (info.output_scanline < img.h) {
-        rowptr = img.data + info.output_scanline * img.w * img.numChannels;
+
+    info.err = jpeg_std_error(&err);
+    jpeg_create_decompress(&info);
+    setJpegSource(&info, file, buf, len);
+    jpeg_read_header(&info, TRUE);
+    setDecodeOptions(&info);
+    jpeg_start_decompress(&info);
+
+    dataSize = (unsigned long)info.output_width * info.output_height * info.output_components;
+    if (dataSize > *capacity) {
+        if (!grow) {
+            jpeg_destroy_decompress(&info);
+            return -1;
+        }
+        pimg->data = (unsigned char *)realloc(pimg->data, dataSize);
+        if (pimg->data == NULL) bailout("read_JPEG_image: out of memory");
+        *capacity = dataSize;
+    }
+
+    pimg->w = info.output_width;
+    pimg->h = info.output_height;
+    pimg->numChannels = info.output_components; // Number of color channels (e.g., RGB or RGBA).
+    pimg->scale = decode_scale;
+    pimg->fullW = info.image_width;
+    pimg->fullH = info.image_height;
+
+    // Read each scanline into the image buffer.
+    while (info.output_scanline < pimg->h) {
+        rowptr = pimg->data + info.output_scanline * pimg->w * pimg->numChannels;
         jpeg_read_scanlines(&info, &rowptr, 1);
     }
 
     jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    return 0;
+}
+
+// Function to read JPEG image data using libjpeg.
+TJImage read_JPEG_image(FILE *file) {
+    static unsigned char *img_data = NULL; // Buffer to hold image data.
+    static unsigned long img_size = 0;     // Capacity of img_data.
+    TJImage img;
+
+    memset(&img, 0, sizeof(img));
+    img.data = img_data;
+    decodeJpeg(file, NULL, 0, &img, &img_size, 1);
+    img_data = img.data;
     return img;
 }
 
+// Function to decode a JPEG stream into a frame supplied by the caller.
+int decodeJpegInto(FILE *file, TJImage *pimg) {
+    return decodeJpeg(file, NULL, 0, pimg, &pimg->capacity, 0);
+}
+
+// Function to decode a JPEG held in memory into a frame supplied by the caller.
+int decodeJpegMemInto(const unsigned char *buf, unsigned long len, TJImage *pimg) {
+    return decodeJpeg(NULL, buf, len, pimg, &pimg->capacity, 0);
+}
+
+// Function to create a pool of preallocated frames.
+TJFramePool *createFramePool(int num_frames, int w, int h, int num_channels) {
+    TJFramePool *pool;
+    unsigned long size = ((unsigned long)w * h * num_channels + FRAME_ALIGN - 1) & ~(unsigned long)(FRAME_ALIGN - 1);
+    int i;
+
+    pool = (TJFramePool *)calloc(1, sizeof(TJFramePool));
+    if (pool == NULL) return NULL;
+    pthread_mutex_init(&pool->lock, NULL);  // before any path to destroyFramePool()
+    pool->frames = (TJImage *)calloc(num_frames, sizeof(TJImage));
+    pool->free = (TJImage **)calloc(num_frames, sizeof(TJImage *));
+    if (pool->frames == NULL || pool->free == NULL) {
+        destroyFramePool(pool);
+        return NULL;
+    }
+    pool->numFrames = num_frames;
+    for (i = 0; i < num_frames; i++) {
+        TJImage *f = &pool->frames[i];
+        if (posix_memalign((void **)&f->data, FRAME_ALIGN, size)) {
+            f->data = NULL;
+            destroyFramePool(pool);
+            return NULL;
+        }
+        f->w = w;
+        f->h = h;
+        f->numChannels = num_channels;
+        f->scale = 1;
+        f->fullW = w;
+        f->fullH = h;
+        f->capacity = size;
+        f->pool = pool;
+        pool->free[pool->numFree++] = f;
+    }
+    return pool;
+}
+
+// Function to free a frame pool and all of its frames.
+void destroyFramePool(TJFramePool *pool) {
+    int i;
+
+    if (pool == NULL) return;
+    if (pool->frames) {
+        for (i = 0; i < pool->numFrames; i++) free(pool->frames[i].data);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->frames);
+    free(pool->free);
+    free(pool);
+}
+
+// Function to take a free frame from the pool, holding one reference.
+TJImage *acquireFrame(TJFramePool *pool) {
+    TJImage *f = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->numFree > 0) f = pool->free[--pool->numFree];
+    pthread_mutex_unlock(&pool->lock);
+    if (f) __atomic_store_n(&f->refs, 1, __ATOMIC_RELAXED);
+    return f;
+}
+
+// Function to add a reference to a pooled frame.
+void retainFrame(TJImage *pimg) {
+    __atomic_add_fetch(&pimg->refs, 1, __ATOMIC_RELAXED);
+}
+
+// Function to drop a reference; the last one returns the frame to its pool.
+void releaseFrame(TJImage *pimg) {
+    TJFramePool *pool = pimg->pool;
+
+    if (__atomic_sub_fetch(&pimg->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->free[pool->numFree++] = pimg;
+    pthread_mutex_unlock(&pool->lock);
+}
+
 // Function to read a JPEG image from a file.
 TJImage readJpegImageFromFile(const char *fname) {
     FILE *file;
@@ -143,6 +974,24 @@ int capturePhotoToFile(const char *fname) {
     return 0;
 }
 
+// Function to capture a photo using the Raspberry Pi camera and decode it into a caller frame.
+int capturePhotoInto(TJImage *pimg) {
+    FILE *fp;
+    char *cmd;
+    int res;
+
+    cmd = MergeStrings(2, CAMERA_CMD, " -o - ");
+    fp = popen(cmd, "r");
+
+    if (fp == NULL) bailout("capturePhotoInto() failed!");
+
+    res = decodeJpegInto(fp, pimg);
+
+    pclose(fp);
+    free(cmd); // Free the dynamically allocated command string.
+    return res;
+}
+
 // Function to capture a photo using the Raspberry Pi camera and return raw image data.
 TJImage capturePhoto() {
     FILE *fp;
@@ -195,3 +1044,94 @@ void writeImageAsJPEG(TJImage *pimg, const char *fname, int quality) {
     jpeg_finish_compress(&cinfo);
     fclose(outfile);
 }
+
+// Function to mark the bounding box and center of a blob and save the image as JPEG.
+void writeImageWithBlobAsJPEG(TBlobSearch blobsearch, const char *fname, int quality) {
+    TJImage img = *blobsearch.pimg;
+    struct blob bb = blobsearch.blob;
+    struct blob *b = &bb;
+    unsigned long dataSize = img.w * img.h * img.numChannels;
+    int x, y, cx, cy;
+
+    // Draw on a copy so the caller's image stays untouched.
+    img.data = (unsigned char *)malloc(dataSize);
+    if (img.data == NULL) bailout("writeImageWithBlobAsJPEG: out of memory");
+    memcpy(img.data, blobsearch.pimg->data, dataSize);
+
+    if (blobsearch.size > 0) {
+        // Blob coordinates are full-frame, the image may be decoded at a smaller scale.
+        int scale = max(img.scale, 1);
+        b->bb_x1 /= scale; b->bb_x2 /= scale;
+        b->bb_y1 /= scale; b->bb_y2 /= scale;
+        b->center_x /= scale; b->center_y /= scale;
+        for (x = b->bb_x1; x <= b->bb_x2; x++) {
+            JImageDATA(&img, x, b->bb_y1, 0) = 0; JImageDATA(&img, x, b->bb_y1, 1) = 255; JImageDATA(&img, x, b->bb_y1, 2) = 0;
+            JImageDATA(&img, x, b->bb_y2, 0) = 0; JImageDATA(&img, x, b->bb_y2, 1) = 255; JImageDATA(&img, x, b->bb_y2, 2) = 0;
+        }
+        for (y = b->bb_y1; y <= b->bb_y2; y++) {
+            JImageDATA(&img, b->bb_x1, y, 0) = 0; JImageDATA(&img, b->bb_x1, y, 1) = 255; JImageDATA(&img, b->bb_x1, y, 2) = 0;
+            JImageDATA(&img, b->bb_x2, y, 0) = 0; JImageDATA(&img, b->bb_x2, y, 1) = 255; JImageDATA(&img, b->bb_x2, y, 2) = 0;
+        }
+        cx = (int)b->center_x;
+        cy = (int)b->center_y;
+        for (x = max(0, cx - 3); x <= min(img.w - 1, cx + 3); x++) {
+            JImageDATA(&img, x, cy, 0) = 0; JImageDATA(&img, x, cy, 1) = 0; JImageDATA(&img, x, cy, 2) = 255;
+        }
+        for (y = max(0, cy - 3); y <= min(img.h - 1, cy + 3); y++) {
+            JImageDATA(&img, cx, y, 0) = 0; JImageDATA(&img, cx, y, 1) = 0; JImageDATA(&img, cx, y, 2) = 255;
+        }
+    }
+
+    writeImageAsJPEG(&img, fname, quality);
+    free(img.data);
+}
+
+// Function to save an image as CSV text, one line per row and "r g b" per pixel.
+void writeImageAsCSV(TJImage *pimg, const char *fname) {
+    FILE *outfile;
+    int x, y, c;
+
+    outfile = fopen(fname, "w");
+    if (outfile == NULL) bailout("writeImageAsCSV: error opening file");
+
+    for (y = 0; y < pimg->h; y++) {
+        for (x = 0; x < pimg->w; x++) {
+            if (x > 0) fputc(',', outfile);
+            for (c = 0; c < pimg->numChannels; c++) {
+                fprintf(outfile, c ? " %d" : "%d", JImageDATA(pimg, x, y, c));
+            }
+        }
+        fputc('\n', outfile);
+    }
+    fclose(outfile);
+}
+
+// Helper function to merge num_args strings into one newly allocated string.
+static char* MergeStrings(int num_args, char* str1, ...) {
+    va_list ap;
+    size_t len = strlen(str1);
+    char *res, *s;
+    int i;
+
+    va_start(ap, str1);
+    for (i = 1; i < num_args; i++) len += strlen(va_arg(ap, char*));
+    va_end(ap);
+
+    res = (char *)malloc(len + 1);
+    if (res == NULL) bailout("MergeStrings: out of memory");
+    strcpy(res, str1);
+
+    va_start(ap, str1);
+    for (i = 1; i < num_args; i++) {
+        s = va_arg(ap, char*);
+        strcat(res, s);
+    }
+    va_end(ap);
+    return res;
+}
+
+// Helper function to print an error message and terminate the program.
+void bailout(char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+    exit(EXIT_FAILURE);
+}
@@ -20,19 +20,53 @@
 
 #include "quickblob.h"
 
+// Limits for imageSearchBlobs()
+#define BLOB_MAX_COLORS 8  // reference colors per pass
+#define BLOB_MAX_TOPK   8  // blobs reported per color
+
+// Limit for setBlobSearchRoi()
+#define BLOB_MAX_ROI QUICKBLOB_MAX_ROI  // windows per search
+
+// Window of followSearchBlob(): the last blob's bounding box grown on every
+// side by BLOB_FOLLOW_GROW times its width/height plus BLOB_FOLLOW_PAD pixels
+#define BLOB_FOLLOW_GROW 0.25
+#define BLOB_FOLLOW_PAD  8
+// Pictures between whole-image searches, which find a larger blob elsewhere
+#define BLOB_FOLLOW_FULL 30
+
+// Color matching rules for setBlobColorRule()
+#define BLOB_RULE_BOX 0  // every RGB channel within +-10% of the reference (default)
+#define BLOB_RULE_HSV 1  // hue/saturation/value distance, copes better with lighting changes
+
+// Labelling engines for setBlobSearchEngine()
+#define BLOB_ENGINE_LISTS      QUICKBLOB_LISTS       // sibling lists (default)
+#define BLOB_ENGINE_UNION_FIND QUICKBLOB_UNION_FIND  // run arrays and union-find labels
+
 //======================================================================
+// Pool of reusable image buffers (see createFramePool())
+typedef struct JFramePool TJFramePool;
+
 // Data structure of still images
 typedef struct JImage {
   int w; // image width (x)
   int h; // image height (y)
   int numChannels; // 3 = RGB, 4 = RGBA
   unsigned char *data;
+  int scale; // decoded at 1/scale of the full frame (1, 2, 4 or 8)
+  int fullW, fullH; // size of the full frame, 0: w*scale x h*scale
+  unsigned long capacity; // bytes available at data (pooled frames)
+  TJFramePool *pool; // owning pool, NULL if the image is not pooled
+  int refs; // reference count of a pooled frame
 } TJImage;
 
 // macro to access raw data of loaded images
 #define JImageDATA(pimg,x,y,c) ((pimg)->data[ (y)*(pimg)->w*(pimg)->numChannels + (x)*(pimg)->numChannels + (c) ])
 
 // Data structure for blob search results
+// Blob coordinates, sizes and coordinate sums are always given in full-frame
+// pixels, whatever scale the image was decoded at (the sums as if each decoded
+// pixel stood for its scale x scale block), and halign/valign are relative to
+// the full frame.
 typedef struct BlobSearch {
   struct blob blob;  // detailed blob data (see quickblob.h)
   double halign;  // horizontal alignment of blob (-1..max left, +1..max right, 0..middle);
@@ -41,24 +75,170 @@ typedef struct BlobSearch {
   TJImage *pimg;  // pointer to the image data this blob belongs to
 } TBlobSearch;
 
+// Window of an image search in full-frame pixels, corners inclusive
+typedef struct BlobRoi {
+  int x1, y1;  // top left corner
+  int x2, y2;  // bottom right corner
+} TBlobRoi;
+
+// State of followSearchBlob(), zero it before the first picture
+typedef struct BlobFollow {
+  TBlobRoi roi;     // window around the last blob
+  int windowed;     // window searches since the last whole-image search
+  unsigned long searches;   // pictures searched
+  unsigned long full;       // of these searched whole, fallbacks included
+} TBlobFollow;
+
 
 //======================================================================
 // cameraSearchBlob():
 // Take a picture and searches there for a blob with the given color.
 // If no blob is found, the size is set to sero.
+// Unless setBlobSearchThreads() asked for a parallel search, the picture is
+// searched while it is decoded (see jpegSearchBlob()) and pimg is NULL.
 // Mem: This function automatically deletes the the image data.
 TBlobSearch cameraSearchBlob(const char color[3]);
 
 // imageSearchBlob():
 // Search in an image for the maximum large blob with the given color.
-// If no blob is found, the size is set to sero.
+// If no blob is found, or the search fails, the size is set to sero.
 TBlobSearch imageSearchBlob(const char color[3], TJImage *pimg);
 
+// imageSearchBlobs():
+// Search in an image for the top_k largest blobs of each of num_colors colors,
+// using a single pass over the image.  Pixels are labelled with the first
+// matching color.  results[i*top_k + k] receives the k-th largest blob of
+// colors[i] (size==0 if there are fewer).  Returns 0, or -1 if num_colors or
+// top_k exceed BLOB_MAX_COLORS / BLOB_MAX_TOPK, or if the search ran out of
+// memory (the results then hold no blobs).
+int imageSearchBlobs(const char colors[][3], int num_colors, int top_k, TJImage *pimg, TBlobSearch results[]);
+
+// jpegSearchBlob():
+// Decode a JPEG stream and search it for the largest blob with the given
+// color.  Each scanline is classified and handed to quickblob as soon as it
+// is decoded, so only one row of RGB data is ever held and pimg is NULL.
+TBlobSearch jpegSearchBlob(FILE *file, const char color[3]);
+
+// jpegSearchBlobs():
+// Streaming variant of imageSearchBlobs() (same colors/top_k/results rules).
+int jpegSearchBlobs(FILE *file, const char colors[][3], int num_colors, int top_k, TBlobSearch results[]);
+
+// jpegMemSearchBlob(), jpegMemSearchBlobs():
+// Same as above for a complete JPEG of len bytes held in memory
+// (e.g. a frame returned by nextCameraFrame()).
+TBlobSearch jpegMemSearchBlob(const unsigned char *buf, unsigned long len, const char color[3]);
+int jpegMemSearchBlobs(const unsigned char *buf, unsigned long len, const char colors[][3], int num_colors, int top_k, TBlobSearch results[]);
+
+// setBlobColorRule():
+// Color matching rule (BLOB_RULE_*) used by the blob searches of the calling
+// thread.  Pixels are classified through lookup tables that are built once
+// per set of reference colors and rule.
+void setBlobColorRule(int rule);
+
+// setBlobSearchThreads():
+// Number of threads used by the blob searches of the calling thread.
+// With threads > 1 every image is split into horizontal bands that are
+// searched in parallel; the results are identical to the serial search.
+void setBlobSearchThreads(int threads);
+
+// setBlobSearchEngine():
+// Labelling engine (BLOB_ENGINE_*) and connectivity (4 or 8) of the blob
+// searches of the calling thread.  Both engines find the same blobs; union-
+// find is much faster on pictures with many small runs (noise, texture).
+// With connectivity 8 pixels touching only at a corner join a blob.  A
+// parallel search (setBlobSearchThreads()) always uses the sibling lists.
+void setBlobSearchEngine(int engine, int connectivity);
+
+// setBlobSearchPacked():
+// With packed set, single-color searches of the calling thread classify
+// every pixel straight into a bit mask, 64 pixels per word, and QuickBlob
+// finds the runs in it a word at a time.  Results are the same as with one
+// byte per pixel (packed = 0, the default).  Searches for several colors
+// always use bytes.  The labelling gets faster on pictures of long runs,
+// but classifying the pixels costs the same either way and dominates.
+void setBlobSearchPacked(int packed);
+
+// setBlobSearchRoi():
+// Restrict the image searches (imageSearchBlob(s), not the jpeg*
+// variants) of the calling thread to num_rois windows, e.g. around the
+// blob found in the previous frame (see blobSearchRoi()).  If the windows
+// hold no blob of any searched color, the whole image is searched after
+// all, so a lost blob costs one extra pass.  Blobs reaching across the
+// edge of a window are cut off there.  num_rois = 0 restores whole-image
+// searches.  Returns 0, or -1 if num_rois exceeds BLOB_MAX_ROI.
+int setBlobSearchRoi(const TBlobRoi rois[], int num_rois);
+
+// blobSearchRoi():
+// Window around the bounding box of a found blob, grown on every side by
+// grow times the box width/height plus pad pixels.
+TBlobRoi blobSearchRoi(const TBlobSearch *blob, double grow, int pad);
+
+// followSearchBlob():
+// imageSearchBlob() for a blob that moves little from picture to picture.
+// While f holds a blob, only a window around it is searched (see
+// BLOB_FOLLOW_*); the whole image is searched every BLOB_FOLLOW_FULL
+// pictures, when the window is empty, and when the blob found touches an
+// edge of the window and may have been cut off.  Windows set with
+// setBlobSearchRoi() are not used.
+TBlobSearch followSearchBlob(TBlobFollow *f, const char color[3], TJImage *pimg);
+
+// setBlobSearchPrune():
+// Blobs of fewer than min_size full-frame pixels are ignored by the
+// searches of the calling thread: they are not reported and do not keep
+// a window search from falling back to the whole image.  With stop_size
+// > 0, a search for the single largest blob of one color ends as soon as
+// a blob of at least stop_size pixels is complete, which need not be the
+// largest one in the picture.  Both 0 (the default) search exhaustively.
+void setBlobSearchPrune(int min_size, int stop_size);
+
+// setBlobSearchPyramid():
+// Search the images of the calling thread coarse to fine.  A first pass
+// labels one pixel of every factor x factor box (factor 2 or 4), and the
+// full-resolution search is then confined to windows reaching one box
+// beyond the candidate blobs it found (setBlobSearchRoi() windows take
+// precedence).  If it finds none, the whole image is searched.  Sizes and
+// centres are exact for every blob the first pass sees, as long as no part
+// of it reaches more than a box beyond the sampled pixels (a thin spike);
+// blobs narrower than a box may be missed.  factor = 1 (the default)
+// searches at full resolution only.
+void setBlobSearchPyramid(int factor);
+
+// getBlobSearchPixels():
+// Number of pixels scanned by the last search of the calling thread,
+// windows, fallback and the first pass of a pyramid search included (the
+// decoded pixels at scale > 1).
+long getBlobSearchPixels(void);
+
+// freeBlobSearch():
+// Release the search buffers of the calling thread (extractors, band threads,
+// scanline buffer).  Call it before a thread that searched for blobs exits;
+// the next search on the thread starts from scratch.
+void freeBlobSearch(void);
+
+// setJpegDecodeScale():
+// Decode the JPEG images of the calling thread at 1/scale of their size
+// (scale = 1, 2, 4 or 8), using libjpeg's DCT scaling.  With fast != 0 the
+// fast integer IDCT is used and chroma upsampling is not smoothed.
+// Blob results are mapped back to the full frame, so halign/valign and
+// the blob coordinates keep their meaning at every scale.
+void setJpegDecodeScale(int scale, int fast);
+
 // read_JPEG_image():
 // Function to read jpeg image data (using libjpeg)
-// Mem: The data buffer of the returned image gets overwritten on each call.
+// Mem: The data buffer of the returned image gets overwritten on each call,
+// use decodeJpegInto() with a frame pool when images outlive the next call.
 TJImage read_JPEG_image (FILE *file);
 
+// decodeJpegInto():
+// Function to decode jpeg image data into a frame supplied by the caller
+// (e.g. from acquireFrame()).  Reentrant: no buffer is shared between calls.
+// Returns 0, or -1 if the image does not fit into pimg->capacity bytes.
+int decodeJpegInto(FILE *file, TJImage *pimg);
+
+// decodeJpegMemInto():
+// Same as decodeJpegInto() for a complete JPEG of len bytes held in memory.
+int decodeJpegMemInto(const unsigned char *buf, unsigned long len, TJImage *pimg);
+
 // readJpegImageFromFile():
 // Function to read jpeg image data (using libjpeg)
 // Mem: The data buffer of the returned image gets overwritten on each call.
@@ -68,11 +248,29 @@ TJImage readJpegImageFromFile (const char *fname);
 // Take a picture via RasperiPI camera and save it as a .jpg file.
 int capturePhotoToFile(const char *fname);
 
+// capturePhotoInto():
+// Take a picture via RasperiPI camera and decode it into a caller frame.
+// Returns the result of decodeJpegInto().
+int capturePhotoInto(TJImage *pimg);
+
 // capturePhoto():
 // Take a picture via RasperiPI camera and return the raw image data
 // Mem: The meory for the image data needs to be explicitly freed.
 TJImage capturePhoto();
 
+// createFramePool():
+// Preallocate num_frames frames of up to w x h x num_channels bytes, with
+// cache-line aligned buffers.  Frames are shared between threads with
+// reference counts instead of copies: acquireFrame() hands out a free
+// frame holding one reference, retainFrame() adds one, and releaseFrame()
+// drops one and returns the frame to the pool when none are left.
+// acquireFrame() returns NULL if every frame is in use.
+TJFramePool *createFramePool(int num_frames, int w, int h, int num_channels);
+void destroyFramePool(TJFramePool *pool);
+TJImage *acquireFrame(TJFramePool *pool);
+void retainFrame(TJImage *pimg);
+void releaseFrame(TJImage *pimg);
+
 // Function to save a loaded image as JPEG file
 // quality: integer 0..100
 void writeImageAsJPEG(TJImage *pimg, const char *fname, int quality);
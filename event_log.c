@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "event_log.h"
+
+// Number of threads that can log, and records buffered per thread
+#define EVENT_LOG_THREADS 8
+#define EVENT_RING_LEN 4096
+
+// Interval of the flush thread (ms)
+#define EVENT_FLUSH_MS 20
+
+// Records by which the file grows when it is full
+#define EVENT_FILE_GROW 65536
+
+// Ring of one writing thread.  head is written by the owner only, tail by
+// the flush thread only.
+typedef struct EventRing {
+    TEventRecord rec[EVENT_RING_LEN];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t seq;             // records attempted by the owner
+    uint64_t dropped;         // records lost because the ring was full
+} TEventRing;
+
+static TEventRing ev_rings[EVENT_LOG_THREADS];
+static int ev_num_rings = 0;
+static __thread int ev_ring_id = -1;
+static uint64_t ev_unregistered = 0;   // events of threads beyond EVENT_LOG_THREADS
+static uint64_t ev_disk_full = 0;      // records skipped because the file could not grow
+
+static int ev_open = 0;
+static int ev_quit = 0;
+static int ev_fd = -1;
+static TEventLogHeader *ev_map = NULL;
+static uint64_t ev_capacity = 0;       // records that fit into the mapped file
+static pthread_t ev_thread;
+
+// Helper function to map the file with room for capacity records.
+// The blocks are allocated first: a sparse file would let a full disk
+// surface as SIGBUS on a store through the mapping.
+static int mapFile(uint64_t capacity) {
+    size_t size = sizeof(TEventLogHeader) + capacity * sizeof(TEventRecord);
+    size_t old = ev_map ? sizeof(TEventLogHeader) + ev_capacity * sizeof(TEventRecord) : 0;
+    TEventLogHeader *map;
+
+    if (posix_fallocate(ev_fd, old, size - old)) {
+        // ENOSPC or EFBIG: drop what was allocated, drainRings() counts the loss
+        if (ftruncate(ev_fd, old)) {
+            // the file keeps unmapped blocks at its end, they are never written
+        }
+        return -1;
+    }
+    map = (TEventLogHeader *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ev_fd, 0);
+    if (map == MAP_FAILED) return -1;
+    if (ev_map) munmap(ev_map, sizeof(TEventLogHeader) + ev_capacity * sizeof(TEventRecord));
+    ev_map = map;
+    ev_capacity = capacity;
+    return 0;
+}
+
+// Helper function to move all buffered records into the file.
+static void drainRings(void) {
+    TEventRecord *out;
+    uint32_t h, t;
+    uint64_t dropped = __atomic_load_n(&ev_unregistered, __ATOMIC_RELAXED);
+    int i, n = __atomic_load_n(&ev_num_rings, __ATOMIC_ACQUIRE);
+
+    if (n > EVENT_LOG_THREADS) n = EVENT_LOG_THREADS;
+    for (i = 0; i < n; i++) {
+        TEventRing *r = &ev_rings[i];
+        h = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        t = r->tail;
+        while (t != h) {
+            if (ev_map->numRecords == ev_capacity && mapFile(ev_capacity + EVENT_FILE_GROW)) {
+                ev_disk_full += h - t;  // disk full: skip what does not fit
+                break;
+            }
+            out = (TEventRecord *)(ev_map + 1);
+            out[ev_map->numRecords++] = r->rec[t % EVENT_RING_LEN];
+            t++;
+        }
+        __atomic_store_n(&r->tail, h, __ATOMIC_RELEASE);
+        dropped += __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+    }
+    ev_map->dropped = dropped + ev_disk_full;  // totals since openEventLog()
+}
+
+// Flush thread.
+static void *flushThread(void *arg) {
+    struct timespec ts = { 0, EVENT_FLUSH_MS * 1000000L };
+
+    while (!__atomic_load_n(&ev_quit, __ATOMIC_ACQUIRE)) {
+        nanosleep(&ts, NULL);
+        drainRings();
+    }
+    drainRings();
+    return NULL;
+}
+
+// Function to create the log file and start flushing.
+int openEventLog(const char *fname) {
+    int i;
+
+    if (ev_open) return -1;
+    // past a file size limit, growing the file fails with EFBIG instead of
+    // killing the process
+    signal(SIGXFSZ, SIG_IGN);
+    ev_fd = open(fname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (ev_fd < 0) return -1;
+    if (mapFile(EVENT_FILE_GROW)) {
+        close(ev_fd);
+        ev_fd = -1;
+        return -1;
+    }
+    memset(ev_map, 0, sizeof(TEventLogHeader));
+    memcpy(ev_map->magic, EVENT_LOG_MAGIC, sizeof(ev_map->magic));
+    ev_map->version = EVENT_LOG_VERSION;
+    ev_map->recordSize = sizeof(TEventRecord);
+
+    // forget records left over from an earlier log
+    for (i = 0; i < EVENT_LOG_THREADS; i++) {
+        ev_rings[i].tail = __atomic_load_n(&ev_rings[i].head, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&ev_rings[i].dropped, 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&ev_unregistered, 0, __ATOMIC_RELAXED);
+    ev_disk_full = 0;
+    ev_quit = 0;
+    if (pthread_create(&ev_thread, NULL, flushThread, NULL)) {
+        munmap(ev_map, sizeof(TEventLogHeader) + ev_capacity * sizeof(TEventRecord));
+        ev_map = NULL;
+        close(ev_fd);
+        ev_fd = -1;
+        return -1;
+    }
+    __atomic_store_n(&ev_open, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// Function to log an event of the calling thread.
+void logEvent(int type, int arg0, int arg1, int arg2, float val) {
+    TEventRing *r;
+    TEventRecord *e;
+    struct timespec ts;
+    uint32_t h;
+
+    if (!__atomic_load_n(&ev_open, __ATOMIC_ACQUIRE)) return;
+    if (ev_ring_id < 0) ev_ring_id = __atomic_fetch_add(&ev_num_rings, 1, __ATOMIC_ACQ_REL);
+    if (ev_ring_id >= EVENT_LOG_THREADS) {
+        __atomic_add_fetch(&ev_unregistered, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    r = &ev_rings[ev_ring_id];
+    h = r->head;
+    if (h - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= EVENT_RING_LEN) {
+        r->seq++;
+        __atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    e = &r->rec[h % EVENT_RING_LEN];
+    e->t = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    e->seq = r->seq++;
+    e->type = type;
+    e->thread = ev_ring_id;
+    e->arg0 = arg0;
+    e->arg1 = arg1;
+    e->arg2 = arg2;
+    e->val = val;
+    e->reserved = 0;
+    __atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+}
+
+// Function to flush and close the log.
+void closeEventLog(void) {
+    uint64_t used;
+
+    if (!ev_open) return;
+    __atomic_store_n(&ev_open, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&ev_quit, 1, __ATOMIC_RELEASE);
+    pthread_join(ev_thread, NULL);
+
+    used = ev_map->numRecords;
+    msync(ev_map, sizeof(TEventLogHeader) + used * sizeof(TEventRecord), MS_SYNC);
+    munmap(ev_map, sizeof(TEventLogHeader) + ev_capacity * sizeof(TEventRecord));
+    ev_map = NULL;
+    ev_capacity = 0;
+    if (ftruncate(ev_fd, sizeof(TEventLogHeader) + used * sizeof(TEventRecord))) {
+        // the file keeps its unused tail; numRecords in the header is still right
+    }
+    close(ev_fd);
+    ev_fd = -1;
+}
@@ -0,0 +1,84 @@
+#ifndef _EVENT_LOG_H_
+#define _EVENT_LOG_H_
+//======================================================================
+//
+// Module for a binary log of the car's behaviour: FSM state changes,
+// sensor readings, blob results and motor commands.  Every thread writes
+// fixed-size records into its own lock-free ring (a clock read and a few
+// stores, no system call); a background thread drains the rings into a
+// memory-mapped file.  If a ring is full the record is dropped and
+// counted, the writer never waits.  So are records that do not fit on the
+// disk: the file is grown with posix_fallocate() and openEventLog() ignores
+// SIGXFSZ, so neither a full disk nor a file size limit stops the process.
+//
+// File layout: a TEventLogHeader followed by TEventRecord entries in the
+// order they were flushed (per thread in time order).  Use the evlogdump
+// tool (tools/evlogdump.c) to print it as CSV.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include <stdint.h>
+
+// Event types and the meaning of their arguments
+#define EV_STATE  1   // FSM state change: arg0 new state, arg1 previous state (EV_STATE_*)
+#define EV_SENSOR 2   // sensors: arg0 IR bits (1 left, 2 right), arg1 ultrasonic cm (-1 not read),
+                      //   arg2 odometry heading (mrad), val odometry speed (m/s)
+#define EV_BLOB   3   // new blob: arg1 size, arg2 blob number, val halign
+#define EV_MOTOR  4   // motor command: arg0 action (MOTOR_*), arg1 speed, arg2 duration ms (0 hold)
+
+// FSM states of camcar()
+#define EV_STATE_NONE 0
+#define EV_STATE_OA   1   // stop to avoid obstacle
+#define EV_STATE_SB   2   // search blob
+#define EV_STATE_AB   3   // align towards blob
+#define EV_STATE_FB   4   // drive forward
+#define EV_STATE_RB   5   // drive backwards
+#define EV_STATE_KD   6   // keep distance
+
+#define EVENT_LOG_MAGIC   "CAMCAREV"
+#define EVENT_LOG_VERSION 1
+
+// File header
+typedef struct EventLogHeader {
+  char magic[8];            // EVENT_LOG_MAGIC
+  uint32_t version;         // EVENT_LOG_VERSION
+  uint32_t recordSize;      // sizeof(TEventRecord)
+  uint64_t numRecords;      // records following the header
+  uint64_t dropped;         // records lost: ring full, disk full or file size
+                            // limit, or logged by too many threads
+} TEventLogHeader;
+
+// One event (32 bytes)
+typedef struct EventRecord {
+  uint64_t t;               // CLOCK_MONOTONIC time in nanoseconds
+  uint32_t seq;             // per-thread record number (gaps show drops)
+  uint8_t type;             // EV_*
+  uint8_t thread;           // index of the writing thread
+  int16_t arg0;
+  int32_t arg1;
+  int32_t arg2;
+  float val;
+  uint32_t reserved;
+} TEventRecord;
+
+
+//======================================================================
+// openEventLog():
+// Create the log file and start the flush thread.  Until then (and after
+// closeEventLog()) logEvent() does nothing.  Returns 0 or -1 on failure.
+int openEventLog(const char *fname);
+
+// logEvent():
+// Append an event to the calling thread's ring.
+void logEvent(int type, int arg0, int arg1, int arg2, float val);
+
+// closeEventLog():
+// Flush all rings, stop the flush thread and close the file.
+void closeEventLog(void);
+
+
+#endif /* _EVENT_LOG_H_ */
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "frame_trace.h"
+
+// Trace record of one frame (times in nanoseconds, 0 = not reached).
+typedef struct TraceRecord {
+    unsigned long seq;
+    long long t[TRACE_POINTS];
+} TTraceRecord;
+
+// Stage between two trace points, as shown in the summary and the trace viewer.
+typedef struct TraceStage {
+    const char *name;
+    int from, to;
+    int tid;                  // lane in the trace viewer
+} TTraceStage;
+
+static const TTraceStage trace_stages[] = {
+    { "decode queue", TRACE_CAPTURE,      TRACE_DECODE_START, 2 },
+    { "decode",       TRACE_DECODE_START, TRACE_DECODE_END,   2 },
+    { "detect queue", TRACE_DECODE_END,   TRACE_DETECT_START, 3 },
+    { "detect",       TRACE_DETECT_START, TRACE_DETECT_END,   3 },
+    { "handoff",      TRACE_DETECT_END,   TRACE_CONSUME,      4 },
+    { "control",      TRACE_CONSUME,      TRACE_ACTUATE,      4 },
+    { "end-to-end",   TRACE_CAPTURE,      TRACE_ACTUATE,      1 },
+};
+#define TRACE_STAGES ((int)(sizeof(trace_stages) / sizeof(trace_stages[0])))
+
+static const char *trace_lanes[] = { NULL, "frames", "decode", "detect", "control" };
+
+static TTraceRecord trace_ring[FRAME_TRACE_LEN];
+static int trace_on = 0;
+
+// Function to switch recording on or off.
+void enableFrameTrace(int on) {
+    __atomic_store_n(&trace_on, on, __ATOMIC_RELEASE);
+}
+
+// Function to stamp a frame at a trace point.
+void traceFrame(unsigned long seq, int point) {
+    TTraceRecord *r = &trace_ring[seq & (FRAME_TRACE_LEN - 1)];
+    struct timespec ts;
+    int i;
+
+    if (!__atomic_load_n(&trace_on, __ATOMIC_ACQUIRE)) return;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (point == TRACE_CAPTURE) {
+        for (i = 1; i < TRACE_POINTS; i++) __atomic_store_n(&r->t[i], 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&r->seq, seq, __ATOMIC_RELEASE);
+    } else if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != seq) {
+        return;  // record already reused by a newer frame
+    }
+    __atomic_store_n(&r->t[point], ts.tv_sec * 1000000000LL + ts.tv_nsec, __ATOMIC_RELAXED);
+}
+
+// Helper function to copy the ring in frame order; returns the number of records.
+static int snapshot(TTraceRecord *out) {
+    int i, n = 0, p;
+
+    for (i = 0; i < FRAME_TRACE_LEN; i++) {
+        out[n].seq = __atomic_load_n(&trace_ring[i].seq, __ATOMIC_ACQUIRE);
+        for (p = 0; p < TRACE_POINTS; p++) out[n].t[p] = __atomic_load_n(&trace_ring[i].t[p], __ATOMIC_RELAXED);
+        if (out[n].seq != 0 && out[n].t[TRACE_CAPTURE] != 0) n++;
+    }
+    return n;
+}
+
+static int cmpRecord(const void *a, const void *b) {
+    unsigned long x = ((const TTraceRecord *)a)->seq, y = ((const TTraceRecord *)b)->seq;
+    return x < y ? -1 : x > y;
+}
+
+static int cmpTime(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Function to export the ring as Chrome trace-event JSON.
+int writeFrameTrace(const char *fname) {
+    TTraceRecord *rec = (TTraceRecord *)malloc(FRAME_TRACE_LEN * sizeof(TTraceRecord));
+    FILE *f;
+    long long t0;
+    int n, i, s, first = 1;
+
+    if (rec == NULL) return -1;
+    f = fopen(fname, "w");
+    if (f == NULL) {
+        free(rec);
+        return -1;
+    }
+    n = snapshot(rec);
+    qsort(rec, n, sizeof(TTraceRecord), cmpRecord);
+    t0 = n > 0 ? rec[0].t[TRACE_CAPTURE] : 0;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (i = 1; i < (int)(sizeof(trace_lanes) / sizeof(trace_lanes[0])); i++) {
+        fprintf(f, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", i, trace_lanes[i]);
+        first = 0;
+    }
+    for (i = 0; i < n; i++) {
+        for (s = 0; s < TRACE_STAGES; s++) {
+            const TTraceStage *st = &trace_stages[s];
+            if (rec[i].t[st->from] == 0 || rec[i].t[st->to] == 0) continue;
+            fprintf(f, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%lu}}",
+                    st->tid, st->name, (rec[i].t[st->from] - t0) / 1e3,
+                    (rec[i].t[st->to] - rec[i].t[st->from]) / 1e3, rec[i].seq);
+        }
+    }
+    fprintf(f, "\n]}\n");
+    free(rec);
+    return fclose(f) ? -1 : 0;
+}
+
+// Function to print latency percentiles per stage.
+void printFrameTraceSummary(FILE *out) {
+    TTraceRecord *rec = (TTraceRecord *)malloc(FRAME_TRACE_LEN * sizeof(TTraceRecord));
+    long long *d = (long long *)malloc(FRAME_TRACE_LEN * sizeof(long long));
+    int n, i, s, k;
+
+    if (rec == NULL || d == NULL) {
+        free(rec);
+        free(d);
+        return;
+    }
+    n = snapshot(rec);
+    fprintf(out, "frame latency over the last %d frames (ms):\n", n);
+    for (s = 0; s < TRACE_STAGES; s++) {
+        const TTraceStage *st = &trace_stages[s];
+        for (i = 0, k = 0; i < n; i++) {
+            if (rec[i].t[st->from] != 0 && rec[i].t[st->to] != 0) d[k++] = rec[i].t[st->to] - rec[i].t[st->from];
+        }
+        if (k == 0) {
+            fprintf(out, "  %-12s: no frames\n", st->name);
+            continue;
+        }
+        qsort(d, k, sizeof(long long), cmpTime);
+        fprintf(out, "  %-12s: p50 %8.3f  p99 %8.3f  max %8.3f  (%d frames)\n",
+                st->name, d[k / 2] / 1e6, d[k * 99 / 100] / 1e6, d[k - 1] / 1e6, k);
+    }
+    free(rec);
+    free(d);
+}
@@ -0,0 +1,58 @@
+#ifndef _FRAME_TRACE_H_
+#define _FRAME_TRACE_H_
+//======================================================================
+//
+// Module that follows every camera frame from its arrival to the motor
+// command it leads to.  Each stage stamps the frame with a monotonic
+// time at fixed trace points; the stamps live in an in-memory ring of
+// FRAME_TRACE_LEN records indexed by frame number, so recording is one
+// clock read and one store, without locks or system calls.
+//
+// The ring can be exported in the Chrome trace-event JSON format (load
+// it in chrome://tracing or Perfetto) and summarised per stage.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include <stdio.h>
+
+// Trace points, in the order a frame passes them
+#define TRACE_CAPTURE      0   // frame complete in the camera stream
+#define TRACE_DECODE_START 1
+#define TRACE_DECODE_END   2
+#define TRACE_DETECT_START 3
+#define TRACE_DETECT_END   4   // result published to the control loop
+#define TRACE_CONSUME      5   // result picked up by the control loop
+#define TRACE_ACTUATE      6   // control decision and motor command done
+#define TRACE_POINTS       7
+
+// Number of frames kept (power of two)
+#define FRAME_TRACE_LEN 4096
+
+
+//======================================================================
+// enableFrameTrace():
+// Start (on != 0) or stop recording.  Recording is off by default.
+void enableFrameTrace(int on);
+
+// traceFrame():
+// Stamp frame seq (the pipeline's frame number, starting at 1) at the
+// given trace point with the current time.  TRACE_CAPTURE starts a new
+// record; each trace point must be stamped by one thread only.
+void traceFrame(unsigned long seq, int point);
+
+// writeFrameTrace():
+// Write the recorded frames as Chrome trace-event JSON.  Returns 0, or -1
+// if the file cannot be written.
+int writeFrameTrace(const char *fname);
+
+// printFrameTraceSummary():
+// Print p50 / p99 / max of every stage, and of the whole path from capture
+// to actuation, over the frames that passed both ends of the stage.
+void printFrameTraceSummary(FILE *out);
+
+
+#endif /* _FRAME_TRACE_H_ */
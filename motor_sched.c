@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <initio.h>
+#include "motor_sched.h"
+#include "event_log.h"
+#include "odometry.h"
+
+struct MotorSched {
+    pthread_mutex_t lock;     // Protects the fields below and all motor calls.
+    pthread_cond_t cond;      // Signalled when a command arrives (CLOCK_MONOTONIC).
+    pthread_t thread;
+    int action;               // Motion currently applied.
+    int speed;
+    int timed;                // A pulse is running and ends at end.
+    struct timespec end;
+    unsigned long preempted;  // Pulses cut short by a later command.
+    int quit;
+};
+
+// Helper function to apply a motion to the motors (called with the lock held).
+static void applyMotion(TMotorSched *ms, int action, int speed) {
+    if (action == ms->action && speed == ms->speed) return;
+    switch (action) {
+        case MOTOR_FORWARD:    initio_DriveForward(speed); break;
+        case MOTOR_REVERSE:    initio_DriveReverse(speed); break;
+        case MOTOR_SPIN_LEFT:  initio_SpinLeft(speed); break;
+        case MOTOR_SPIN_RIGHT: initio_SpinRight(speed); break;
+        default:               initio_DriveForward(0); speed = 0; break;
+    }
+    // direction of the wheel sensor edges to come (stopped wheels keep theirs)
+    if (speed > 0) {
+        setOdometryDirection(action == MOTOR_REVERSE || action == MOTOR_SPIN_LEFT ? -1 : 1,
+                             action == MOTOR_REVERSE || action == MOTOR_SPIN_RIGHT ? -1 : 1);
+    }
+    ms->action = action;
+    ms->speed = speed;
+}
+
+// Helper function to replace the running command (called with the lock held).
+static void setCommand(TMotorSched *ms, int action, int speed, int duration_ms) {
+    if (ms->timed) ms->preempted++;
+    if (action != ms->action || speed != ms->speed || duration_ms > 0) {
+        logEvent(EV_MOTOR, action, speed, duration_ms, 0);
+    }
+    applyMotion(ms, action, speed);
+    ms->timed = 0;
+    if (duration_ms > 0 && action != MOTOR_STOP) {
+        clock_gettime(CLOCK_MONOTONIC, &ms->end);
+        ms->end.tv_sec += duration_ms / 1000;
+        ms->end.tv_nsec += (duration_ms % 1000) * 1000000L;
+        if (ms->end.tv_nsec >= 1000000000L) {
+            ms->end.tv_sec++;
+            ms->end.tv_nsec -= 1000000000L;
+        }
+        ms->timed = 1;
+    }
+    pthread_cond_signal(&ms->cond);
+}
+
+// Scheduler thread: stops the motors when a pulse reaches its end.
+static void *motorThread(void *arg) {
+    TMotorSched *ms = (TMotorSched *)arg;
+    struct timespec now;
+
+    pthread_mutex_lock(&ms->lock);
+    while (!ms->quit) {
+        if (!ms->timed) {
+            pthread_cond_wait(&ms->cond, &ms->lock);
+            continue;
+        }
+        pthread_cond_timedwait(&ms->cond, &ms->lock, &ms->end);
+        // the pulse may have been replaced while waiting
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (ms->timed && (now.tv_sec > ms->end.tv_sec ||
+                          (now.tv_sec == ms->end.tv_sec && now.tv_nsec >= ms->end.tv_nsec))) {
+            logEvent(EV_MOTOR, MOTOR_STOP, 0, 0, 0);
+            applyMotion(ms, MOTOR_STOP, 0);
+            ms->timed = 0;
+        }
+    }
+    pthread_mutex_unlock(&ms->lock);
+    return NULL;
+}
+
+// Function to start the scheduler.
+TMotorSched *startMotorSched(void) {
+    TMotorSched *ms = (TMotorSched *)calloc(1, sizeof(TMotorSched));
+    pthread_condattr_t attr;
+
+    if (ms == NULL) return NULL;
+    pthread_mutex_init(&ms->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ms->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    ms->action = -1;  // motor state unknown: the first command is always applied
+    if (pthread_create(&ms->thread, NULL, motorThread, ms)) {
+        pthread_cond_destroy(&ms->cond);
+        pthread_mutex_destroy(&ms->lock);
+        free(ms);
+        return NULL;
+    }
+    return ms;
+}
+
+// Function to start a (timed) motion.
+void motorPulse(TMotorSched *ms, int action, int speed, int duration_ms) {
+    pthread_mutex_lock(&ms->lock);
+    setCommand(ms, action, speed, duration_ms);
+    pthread_mutex_unlock(&ms->lock);
+}
+
+// Function to stop the motors at once.
+void motorStop(TMotorSched *ms) {
+    motorPulse(ms, MOTOR_STOP, 0, 0);
+}
+
+// Function to check for a running pulse.
+int motorBusy(TMotorSched *ms) {
+    int busy;
+
+    pthread_mutex_lock(&ms->lock);
+    busy = ms->timed;
+    pthread_mutex_unlock(&ms->lock);
+    return busy;
+}
+
+// Function to return the number of preempted pulses.
+unsigned long motorPreempted(TMotorSched *ms) {
+    unsigned long n;
+
+    pthread_mutex_lock(&ms->lock);
+    n = ms->preempted;
+    pthread_mutex_unlock(&ms->lock);
+    return n;
+}
+
+// Function to stop the motors and the scheduler.
+void stopMotorSched(TMotorSched *ms) {
+    pthread_mutex_lock(&ms->lock);
+    setCommand(ms, MOTOR_STOP, 0, 0);
+    ms->quit = 1;
+    pthread_cond_signal(&ms->cond);
+    pthread_mutex_unlock(&ms->lock);
+    pthread_join(ms->thread, NULL);
+    pthread_cond_destroy(&ms->cond);
+    pthread_mutex_destroy(&ms->lock);
+    free(ms);
+}
@@ -0,0 +1,60 @@
+#ifndef _MOTOR_SCHED_H_
+#define _MOTOR_SCHED_H_
+//======================================================================
+//
+// Module that drives the motors with timed commands ("spin left at 40
+// for 150 ms, then stop") without blocking the caller.  A scheduler
+// thread ends each pulse at its deadline, so the control loop keeps
+// iterating (and checking the obstacle sensors) while the car moves,
+// and motorStop() cuts a running pulse short at once.
+//
+// All motor calls of the program should go through this module, so the
+// initio motor functions are never called from two threads at a time.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+// Motor actions
+#define MOTOR_STOP       0
+#define MOTOR_FORWARD    1
+#define MOTOR_REVERSE    2
+#define MOTOR_SPIN_LEFT  3
+#define MOTOR_SPIN_RIGHT 4
+
+// Handle of a running scheduler
+typedef struct MotorSched TMotorSched;
+
+
+//======================================================================
+// startMotorSched():
+// Start the scheduler thread.  The thread inherits scheduling policy and
+// CPU affinity of the caller.  Returns NULL on failure.
+TMotorSched *startMotorSched(void);
+
+// motorPulse():
+// Start action at speed now, replacing any running command.  After
+// duration_ms the motors are stopped; with duration_ms == 0 the action
+// is kept until the next command.
+void motorPulse(TMotorSched *ms, int action, int speed, int duration_ms);
+
+// motorStop():
+// Stop the motors immediately, cancelling a running pulse.
+void motorStop(TMotorSched *ms);
+
+// motorBusy():
+// Returns non-zero while a timed pulse is running.
+int motorBusy(TMotorSched *ms);
+
+// motorPreempted():
+// Number of timed pulses cut short by a later command.
+unsigned long motorPreempted(TMotorSched *ms);
+
+// stopMotorSched():
+// Stop the motors, join the scheduler thread and free it.
+void stopMotorSched(TMotorSched *ms);
+
+
+#endif /* _MOTOR_SCHED_H_ */
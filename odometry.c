@@ -0,0 +1,156 @@
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <initio.h>
+#include "odometry.h"
+#include "periodic.h"
+
+#define NSEC_PER_MSEC 1000000LL
+
+#define WHEEL_LEFT  0
+#define WHEEL_RIGHT 1
+
+// State of one wheel (guarded by odo_lock, dir is atomic)
+typedef struct OdoWheel {
+    unsigned long ticks;
+    long long t;              // time of the last edge (ns)
+    long long interval;       // time between the last two edges (ns, 0: unknown)
+    int dir;                  // sign of the wheel motion (-1, 1)
+} TOdoWheel;
+
+static pthread_mutex_t odo_lock = PTHREAD_MUTEX_INITIALIZER;
+static TOdoWheel wheel[2];
+static double pose_x, pose_y, pose_heading, pose_distance;
+static int odo_mode = 0;      // mode in use, 0: not counting
+static pthread_t poll_thread;
+static int poll_quit;
+
+// Helper function to count one edge of a wheel and move the pose along:
+// the wheel rolls ODO_SLOT while the other one stands.
+static void wheelEdge(int w) {
+    long long t = monoTimeNs();
+    TOdoWheel *wh = &wheel[w];
+    double ds, dth;
+
+    pthread_mutex_lock(&odo_lock);
+    if (!__atomic_load_n(&odo_mode, __ATOMIC_RELAXED) ||
+        (wh->ticks && t - wh->t < ODO_DEBOUNCE_MS * NSEC_PER_MSEC)) {
+        pthread_mutex_unlock(&odo_lock);
+        return;
+    }
+    wh->interval = wh->ticks ? t - wh->t : 0;
+    wh->t = t;
+    wh->ticks++;
+
+    ds = __atomic_load_n(&wh->dir, __ATOMIC_RELAXED) * ODO_SLOT;
+    dth = (w == WHEEL_RIGHT ? ds : -ds) / ODO_WHEEL_BASE;
+    pose_x += ds / 2 * cos(pose_heading + dth / 2);
+    pose_y += ds / 2 * sin(pose_heading + dth / 2);
+    pose_heading = remainder(pose_heading + dth, 2 * M_PI);
+    pose_distance += ODO_SLOT / 2;
+    pthread_mutex_unlock(&odo_lock);
+}
+
+// Interrupt handlers (wiringPi passes no argument)
+static void edgeLeft(void)  { wheelEdge(WHEEL_LEFT); }
+static void edgeRight(void) { wheelEdge(WHEEL_RIGHT); }
+
+// Polling thread: looks for level changes of the wheel sensors at ODO_POLL_HZ.
+static void *pollThread(void *arg) {
+    struct timespec next;
+    int left, right, l, r;
+
+    left = initio_wheelSensorLeft() != 0;
+    right = initio_wheelSensorRight() != 0;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!__atomic_load_n(&poll_quit, __ATOMIC_ACQUIRE)) {
+        next.tv_nsec += NSEC_PER_SEC / ODO_POLL_HZ;
+        if (next.tv_nsec >= NSEC_PER_SEC) {
+            next.tv_sec++;
+            next.tv_nsec -= NSEC_PER_SEC;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
+
+        l = initio_wheelSensorLeft() != 0;
+        r = initio_wheelSensorRight() != 0;
+        if (l != left) edgeLeft();
+        if (r != right) edgeRight();
+        left = l;
+        right = r;
+    }
+    return NULL;
+}
+
+// Helper function for the speed of a wheel at time now: the last edge
+// interval, or less if the next edge is overdue.
+static double wheelSpeed(const TOdoWheel *wh, long long now) {
+    long long dt = now - wh->t;
+
+    if (wh->interval == 0 || dt > ODO_STOPPED_MS * NSEC_PER_MSEC) return 0.0;
+    if (dt < wh->interval) dt = wh->interval;
+    return __atomic_load_n(&wh->dir, __ATOMIC_RELAXED) * ODO_SLOT * NSEC_PER_SEC / dt;
+}
+
+// Function to start counting.
+int startOdometry(int mode) {
+    pthread_mutex_lock(&odo_lock);
+    memset(wheel, 0, sizeof(wheel));
+    wheel[WHEEL_LEFT].dir = wheel[WHEEL_RIGHT].dir = 1;
+    pose_x = pose_y = pose_heading = pose_distance = 0.0;
+    pthread_mutex_unlock(&odo_lock);
+
+    if (mode == ODO_ISR) {
+        __atomic_store_n(&odo_mode, ODO_ISR, __ATOMIC_RELEASE);
+        if (wiringPiISR(wheelLeft, INT_EDGE_BOTH, edgeLeft) >= 0 &&
+            wiringPiISR(wheelRight, INT_EDGE_BOTH, edgeRight) >= 0) {
+            return ODO_ISR;
+        }
+        // a handler that did register stays; the poller takes over its edges
+    }
+    __atomic_store_n(&odo_mode, ODO_POLLED, __ATOMIC_RELEASE);
+    poll_quit = 0;
+    if (pthread_create(&poll_thread, NULL, pollThread, NULL)) {
+        __atomic_store_n(&odo_mode, 0, __ATOMIC_RELEASE);
+        return 0;
+    }
+    return ODO_POLLED;
+}
+
+// Function to set the direction of the wheels.
+void setOdometryDirection(int left, int right) {
+    if (left) __atomic_store_n(&wheel[WHEEL_LEFT].dir, left > 0 ? 1 : -1, __ATOMIC_RELAXED);
+    if (right) __atomic_store_n(&wheel[WHEEL_RIGHT].dir, right > 0 ? 1 : -1, __ATOMIC_RELAXED);
+}
+
+// Function to take a snapshot.
+void getOdometry(TOdometry *odo) {
+    long long now = monoTimeNs();
+
+    pthread_mutex_lock(&odo_lock);
+    odo->ticksL = wheel[WHEEL_LEFT].ticks;
+    odo->ticksR = wheel[WHEEL_RIGHT].ticks;
+    odo->tL = wheel[WHEEL_LEFT].t;
+    odo->tR = wheel[WHEEL_RIGHT].t;
+    odo->speedL = wheelSpeed(&wheel[WHEEL_LEFT], now);
+    odo->speedR = wheelSpeed(&wheel[WHEEL_RIGHT], now);
+    odo->x = pose_x;
+    odo->y = pose_y;
+    odo->heading = pose_heading;
+    odo->distance = pose_distance;
+    pthread_mutex_unlock(&odo_lock);
+
+    odo->speed = (odo->speedL + odo->speedR) / 2;
+    odo->turnRate = (odo->speedR - odo->speedL) / ODO_WHEEL_BASE;
+}
+
+// Function to stop counting.
+void stopOdometry(void) {
+    int mode = __atomic_exchange_n(&odo_mode, 0, __ATOMIC_ACQ_REL);
+
+    if (mode == ODO_POLLED) {
+        __atomic_store_n(&poll_quit, 1, __ATOMIC_RELEASE);
+        pthread_join(poll_thread, NULL);
+    }
+}
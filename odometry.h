@@ -0,0 +1,70 @@
+#ifndef _ODOMETRY_H_
+#define _ODOMETRY_H_
+//======================================================================
+//
+// Module that counts the edges of the wheel sensors and turns them into
+// wheel speeds and a dead-reckoned pose.  Edges are taken from GPIO
+// interrupts (wiringPiISR) or, where these are not available, from a
+// thread polling the sensor pins.
+//
+// Only one of the two phase-shifted encoder signals per wheel is wired
+// (see initio.h), so the sensors tell that a wheel turns but not which
+// way: the direction comes from the motor commands (setOdometryDirection()).
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+// Source of the wheel sensor edges
+#define ODO_ISR    1    // GPIO interrupts
+#define ODO_POLLED 2    // polling thread
+
+// Geometry: wheel travel between two sensor edges, distance between the wheels (m)
+#define ODO_SLOT 0.01
+#define ODO_WHEEL_BASE 0.14
+
+// Polling rate of the fallback (Hz), shortest time between two edges of
+// one wheel (contact bounce), and the time without an edge after which a
+// wheel counts as standing (ms)
+#define ODO_POLL_HZ 2000
+#define ODO_DEBOUNCE_MS 2
+#define ODO_STOPPED_MS 250
+
+// Snapshot of the odometry
+typedef struct Odometry {
+  unsigned long ticksL, ticksR; // edges counted per wheel
+  long long tL, tR;         // CLOCK_MONOTONIC time of the last edge (ns, 0: none yet)
+  double speedL, speedR;    // signed wheel speeds (m/s)
+  double speed;             // forward speed of the car (m/s)
+  double turnRate;          // rate of turn (rad/s, positive to the left)
+  double x, y, heading;     // pose relative to the start (m, rad; x ahead at start)
+  double distance;          // path length driven (m)
+} TOdometry;
+
+
+//======================================================================
+// startOdometry():
+// Start counting wheel sensor edges from mode (ODO_ISR or ODO_POLLED).
+// ODO_ISR falls back to polling if the interrupts cannot be registered
+// (wiringPi exits instead of failing unless WIRINGPI_CODES is set).
+// Returns the mode in use, 0 on failure.
+int startOdometry(int mode);
+
+// setOdometryDirection():
+// Tell the odometry which way the wheels are driven (sign of the motor
+// commands).  A wheel with direction 0 keeps its previous direction, so
+// the edges of a coasting wheel still count the right way.
+void setOdometryDirection(int left, int right);
+
+// getOdometry():
+// Take a snapshot of tick counts, speeds and pose.
+void getOdometry(TOdometry *odo);
+
+// stopOdometry():
+// Stop counting.  (Interrupt handlers cannot be removed; later edges are ignored.)
+void stopOdometry(void);
+
+
+#endif /* _ODOMETRY_H_ */
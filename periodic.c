@@ -0,0 +1,110 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "periodic.h"
+
+// Helper function to convert a time to nanoseconds.
+static long long toNsec(const struct timespec *ts) {
+    return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+// Helper function to convert nanoseconds to a time.
+static void fromNsec(struct timespec *ts, long long ns) {
+    ts->tv_sec = ns / NSEC_PER_SEC;
+    ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+// Function to set priority and CPU affinity of a thread.
+int setThreadRealtime(pthread_t thread, int prio, unsigned long cpus) {
+    struct sched_param param;
+    cpu_set_t set;
+    int i, res = 0;
+
+    if (prio > 0) {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = prio;
+        if (pthread_setschedparam(thread, SCHED_FIFO, &param) == 0) res |= RT_FIFO;
+    }
+    if (cpus) {
+        CPU_ZERO(&set);
+        for (i = 0; i < (int)(8 * sizeof(cpus)); i++) {
+            if (cpus & (1UL << i)) CPU_SET(i, &set);
+        }
+        if (pthread_setaffinity_np(thread, sizeof(set), &set) == 0) res |= RT_PINNED;
+    }
+    return res;
+}
+
+// Function to lock the process memory.
+int lockMemory(void) {
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0 ? RT_LOCKED : 0;
+}
+
+// Function to set up a periodic loop.
+void initPeriodic(TPeriodic *per, long period_us) {
+    memset(per, 0, sizeof(TPeriodic));
+    per->period = period_us * 1000LL;
+    per->stats.latMin = per->stats.execMin = -1;
+}
+
+// Function to wait for the next period.
+int waitPeriod(TPeriodic *per) {
+    TPeriodicStats *st = &per->stats;
+    struct timespec now;
+    long long t, next, exec, lat;
+    int skipped = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    t = toNsec(&now);
+    if (!per->started) {
+        per->started = 1;
+        per->next = now;
+        per->wake = now;
+        return 0;
+    }
+
+    // execution time of the previous iteration
+    exec = t - toNsec(&per->wake);
+    if (st->execMin < 0 || exec < st->execMin) st->execMin = exec;
+    if (exec > st->execMax) st->execMax = exec;
+    st->execSum += exec;
+    st->cycles++;
+
+    // a deadline is missed if the body ran into the next period
+    next = toNsec(&per->next) + per->period;
+    if (t > next) {
+        st->missed++;
+        skipped = (int)((t - next) / per->period) + 1;
+        next += skipped * per->period;
+    }
+    fromNsec(&per->next, next);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &per->next, NULL) == EINTR);
+
+    clock_gettime(CLOCK_MONOTONIC, &per->wake);
+    lat = toNsec(&per->wake) - next;
+    if (st->latMin < 0 || lat < st->latMin) st->latMin = lat;
+    if (lat > st->latMax) st->latMax = lat;
+    st->latSum += lat;
+    return skipped;
+}
+
+// Function to copy the statistics.
+void getPeriodicStats(TPeriodic *per, TPeriodicStats *st) {
+    *st = per->stats;
+}
+
+// Function to read the monotonic clock in nanoseconds.
+long long monoTimeNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return toNsec(&ts);
+}
+
+// Function to read the monotonic clock in seconds.
+double monoTime(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
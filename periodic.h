@@ -0,0 +1,85 @@
+#ifndef _PERIODIC_H_
+#define _PERIODIC_H_
+//======================================================================
+//
+// Module that runs a loop at a fixed rate and keeps timing statistics
+// (wake-up latency, execution time, missed deadlines).  Wake-ups are
+// scheduled on absolute CLOCK_MONOTONIC times, so the period does not
+// drift with the execution time of the loop body.
+//
+// The real-time setup (SCHED_FIFO, CPU pinning, mlockall) is optional:
+// every step that is not permitted is skipped and reported, so the loop
+// also runs unprivileged on a development machine.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include <pthread.h>
+#include <time.h>
+
+#define NSEC_PER_SEC 1000000000LL
+
+// Flags returned by setThreadRealtime() and lockMemory() for the steps that succeeded
+#define RT_FIFO   1     // running with SCHED_FIFO
+#define RT_PINNED 2     // pinned to the requested CPUs
+#define RT_LOCKED 4     // memory locked
+
+// Timing statistics (all times in nanoseconds)
+typedef struct PeriodicStats {
+  unsigned long cycles;     // completed periods
+  unsigned long missed;     // periods whose deadline was missed
+  long long latMin, latMax; // wake-up latency: actual minus planned wake-up
+  long long latSum;
+  long long execMin, execMax; // execution time of the loop body
+  long long execSum;
+} TPeriodicStats;
+
+// State of a periodic loop
+typedef struct Periodic {
+  long long period;         // period in nanoseconds
+  struct timespec next;     // planned start of the current period
+  struct timespec wake;     // actual start of the current period
+  int started;              // the first period has begun
+  TPeriodicStats stats;
+} TPeriodic;
+
+
+//======================================================================
+// setThreadRealtime():
+// Give a thread SCHED_FIFO priority prio (0: keep the normal policy) and
+// pin it to the CPUs in the bit mask cpus (0: no pinning).  Returns the
+// RT_* flags of the steps that succeeded.
+int setThreadRealtime(pthread_t thread, int prio, unsigned long cpus);
+
+// lockMemory():
+// Lock all current and future pages of the process into RAM.
+// Returns RT_LOCKED on success, 0 if not permitted.
+int lockMemory(void);
+
+// initPeriodic():
+// Set up a loop with the given period in microseconds.
+void initPeriodic(TPeriodic *per, long period_us);
+
+// waitPeriod():
+// Call at the top of every loop iteration.  Accounts the execution time of
+// the previous iteration, sleeps until the start of the next period and
+// accounts the wake-up latency.  If a deadline was missed, the missed
+// periods are skipped so the loop does not try to catch up.
+// Returns the number of periods skipped (0 normally).
+int waitPeriod(TPeriodic *per);
+
+// getPeriodicStats():
+// Copy the statistics collected so far.
+void getPeriodicStats(TPeriodic *per, TPeriodicStats *st);
+
+// monoTimeNs(), monoTime():
+// CLOCK_MONOTONIC time in nanoseconds / in seconds.  The time stamps of
+// the program (capture times, sensor samples, wheel edges) all use it.
+long long monoTimeNs(void);
+double monoTime(void);
+
+
+#endif /* _PERIODIC_H_ */
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "pipeline.h"
+#include "periodic.h"
+#include "frame_trace.h"
+
+// Number of work items: one per stage plus full queues, and one spare.
+#define PIPE_ITEMS (PIPE_STAGES + 2 * PIPE_QUEUE_LEN + 1)
+
+// Number of decoded frames: decode and detect stage plus the detect queue,
+// and one more for a result callback that retains its frame.
+#define PIPE_FRAMES (2 + PIPE_QUEUE_LEN + 1)
+
+// One frame travelling through the pipeline.
+typedef struct PipeItem {
+    unsigned long seq;        // Frame number assigned by the capture stage.
+    double t;                 // Time the frame was captured (CLOCK_MONOTONIC seconds).
+    unsigned char *jpeg;      // Copy of the compressed frame.
+    size_t len;               // Bytes used in jpeg.
+    size_t cap;               // Bytes allocated for jpeg.
+    TJImage *img;             // Decoded frame (from the frame pool), or NULL.
+} TPipeItem;
+
+// Bounded SPSC ring with drop-oldest.  The consumer pops and the producer
+// drops by advancing head with a CAS, so whoever wins owns the entry.
+typedef struct PipeQueue {
+    TPipeItem *slot[PIPE_QUEUE_LEN];
+    unsigned long head;       // Next entry to pop.
+    unsigned long tail;       // Next entry to push, written by the producer only.
+    sem_t items;              // Posted for every push.
+} TPipeQueue;
+
+struct Pipeline {
+    TCamStream *cs;
+    char color[3];
+    TPipeResultFn fn;
+    void *ctx;
+    TJFramePool *frames;
+    TPipeItem items[PIPE_ITEMS];
+    TPipeItem *free[PIPE_ITEMS];  // Stack of unused items.
+    int numFree;
+    pthread_mutex_t freeLock;     // Protects the free stack (touched once per frame).
+    TPipeQueue queue[PIPE_STAGES];  // Input queues of decode and detect (index 0 unused).
+    pthread_t thread[PIPE_STAGES];
+    TPipeStageStats stats[PIPE_STAGES];
+    unsigned long long busyNs[PIPE_STAGES];  // Busy time of each stage, see busyAdd().
+    double start;                 // Start time (monoTime()).
+    int quit;
+    int done[PIPE_STAGES];        // Stage has finished (end of stream or stop).
+};
+
+// Helper function to add to a statistics counter shared between threads.
+static void statAdd(unsigned long *counter, unsigned long n) {
+    __atomic_add_fetch(counter, n, __ATOMIC_RELAXED);
+}
+
+// Helper function to add the time since t0 to the busy time of a stage.
+// Kept as integer nanoseconds, so getPipelineStats() can read it atomically
+// while the stage is running.
+static void busyAdd(TPipeline *pl, int stage, double t0) {
+    __atomic_add_fetch(&pl->busyNs[stage], (unsigned long long)((monoTime() - t0) * 1e9), __ATOMIC_RELAXED);
+}
+
+// Helper function to take an unused item, NULL if there is none.
+static TPipeItem *getItem(TPipeline *pl) {
+    TPipeItem *it = NULL;
+
+    pthread_mutex_lock(&pl->freeLock);
+    if (pl->numFree > 0) it = pl->free[--pl->numFree];
+    pthread_mutex_unlock(&pl->freeLock);
+    return it;
+}
+
+// Helper function to return an item and its decoded frame.
+static void putItem(TPipeline *pl, TPipeItem *it) {
+    if (it->img) {
+        releaseFrame(it->img);
+        it->img = NULL;
+    }
+    pthread_mutex_lock(&pl->freeLock);
+    pl->free[pl->numFree++] = it;
+    pthread_mutex_unlock(&pl->freeLock);
+}
+
+// Helper function to push an item; returns the oldest entry if it had to be dropped.
+static TPipeItem *queuePush(TPipeQueue *q, TPipeItem *it, TPipeStageStats *st) {
+    unsigned long t = q->tail;
+    unsigned long h = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    TPipeItem *dropped = NULL;
+    int depth;
+
+    while (t - h >= PIPE_QUEUE_LEN) {
+        dropped = __atomic_load_n(&q->slot[h % PIPE_QUEUE_LEN], __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&q->head, &h, h + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) break;
+        dropped = NULL;  // the consumer took it, h has been reloaded
+    }
+    __atomic_store_n(&q->slot[t % PIPE_QUEUE_LEN], it, __ATOMIC_RELAXED);
+    __atomic_store_n(&q->tail, t + 1, __ATOMIC_RELEASE);
+    sem_post(&q->items);
+
+    depth = (int)(t + 1 - __atomic_load_n(&q->head, __ATOMIC_RELAXED));
+    if (depth > st->maxDepth) __atomic_store_n(&st->maxDepth, depth, __ATOMIC_RELAXED);
+    return dropped;
+}
+
+// Helper function to pop an item, NULL if the queue is empty.
+static TPipeItem *queuePop(TPipeQueue *q) {
+    unsigned long h = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    TPipeItem *it;
+
+    while (h != __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE)) {
+        it = __atomic_load_n(&q->slot[h % PIPE_QUEUE_LEN], __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&q->head, &h, h + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return it;
+    }
+    return NULL;
+}
+
+// Helper function to block until an item arrives for stage s.
+// Returns NULL once the pipeline stops or the stage in front has finished.
+static TPipeItem *waitItem(TPipeline *pl, int s) {
+    TPipeItem *it;
+
+    while (1) {
+        it = queuePop(&pl->queue[s]);
+        if (it) return it;
+        if (__atomic_load_n(&pl->quit, __ATOMIC_ACQUIRE) ||
+            __atomic_load_n(&pl->done[s - 1], __ATOMIC_ACQUIRE)) {
+            return queuePop(&pl->queue[s]);
+        }
+        // drops leave extra posts behind, so a wake-up may find the queue empty
+        sem_wait(&pl->queue[s].items);
+    }
+}
+
+// Helper function to hand an item to stage s, recycling a dropped one.
+static void passItem(TPipeline *pl, int s, TPipeItem *it) {
+    TPipeItem *dropped = queuePush(&pl->queue[s], it, &pl->stats[s]);
+
+    if (dropped) {
+        statAdd(&pl->stats[s].dropped, 1);
+        putItem(pl, dropped);
+    }
+}
+
+// Helper function to mark stage s finished and wake the stage behind it.
+static void finishStage(TPipeline *pl, int s) {
+    __atomic_store_n(&pl->done[s], 1, __ATOMIC_RELEASE);
+    if (s + 1 < PIPE_STAGES) sem_post(&pl->queue[s + 1].items);
+}
+
+// Capture stage: copies each frame out of the stream buffer.
+static void *captureStage(void *arg) {
+    TPipeline *pl = (TPipeline *)arg;
+    TPipeStageStats *st = &pl->stats[PIPE_CAPTURE];
+    const unsigned char *jpeg;
+    size_t len;
+    unsigned long seq = 0;
+    TPipeItem *it;
+    unsigned char *buf;
+    double t0;
+
+    while (!__atomic_load_n(&pl->quit, __ATOMIC_ACQUIRE) && nextCameraFrame(pl->cs, &jpeg, &len)) {
+        t0 = monoTime();
+        seq++;
+        traceFrame(seq, TRACE_CAPTURE);
+        it = getItem(pl);
+        if (it && len > it->cap) {
+            buf = (unsigned char *)realloc(it->jpeg, len);
+            if (buf == NULL) {
+                putItem(pl, it);
+                it = NULL;
+            } else {
+                it->jpeg = buf;
+                it->cap = len;
+            }
+        }
+        if (it == NULL) {
+            statAdd(&st->dropped, 1);
+            continue;
+        }
+        memcpy(it->jpeg, jpeg, len);
+        it->len = len;
+        it->seq = seq;
+        it->t = t0;
+        passItem(pl, PIPE_DECODE, it);
+        busyAdd(pl, PIPE_CAPTURE, t0);
+        statAdd(&st->frames, 1);
+    }
+    finishStage(pl, PIPE_CAPTURE);
+    return NULL;
+}
+
+// Decode stage: decodes each JPEG into a pooled frame.
+static void *decodeStage(void *arg) {
+    TPipeline *pl = (TPipeline *)arg;
+    TPipeStageStats *st = &pl->stats[PIPE_DECODE];
+    TPipeItem *it;
+    double t0;
+
+    while ((it = waitItem(pl, PIPE_DECODE)) != NULL) {
+        t0 = monoTime();
+        traceFrame(it->seq, TRACE_DECODE_START);
+        it->img = acquireFrame(pl->frames);
+        if (it->img == NULL || decodeJpegMemInto(it->jpeg, it->len, it->img)) {
+            statAdd(&st->dropped, 1);
+            putItem(pl, it);
+            continue;
+        }
+        traceFrame(it->seq, TRACE_DECODE_END);
+        passItem(pl, PIPE_DETECT, it);
+        busyAdd(pl, PIPE_DECODE, t0);
+        statAdd(&st->frames, 1);
+    }
+    finishStage(pl, PIPE_DECODE);
+    return NULL;
+}
+
+// Detect stage: searches each decoded frame and reports the result.
+static void *detectStage(void *arg) {
+    TPipeline *pl = (TPipeline *)arg;
+    TPipeStageStats *st = &pl->stats[PIPE_DETECT];
+    TPipeItem *it;
+    TBlobSearch blob;
+    TBlobFollow follow;
+    double t0;
+
+    memset(&follow, 0, sizeof(follow));
+    setBlobSearchPrune(PIPE_MIN_BLOB, 0);
+    while ((it = waitItem(pl, PIPE_DETECT)) != NULL) {
+        t0 = monoTime();
+        traceFrame(it->seq, TRACE_DETECT_START);
+        blob = followSearchBlob(&follow, pl->color, it->img);
+        traceFrame(it->seq, TRACE_DETECT_END);
+        pl->fn(pl->ctx, &blob, it->seq, it->t);
+        putItem(pl, it);
+        busyAdd(pl, PIPE_DETECT, t0);
+        statAdd(&st->frames, 1);
+    }
+    setBlobSearchPrune(0, 0);
+    freeBlobSearch();
+    finishStage(pl, PIPE_DETECT);
+    return NULL;
+}
+
+// Function to start the capture, decode and detect threads.
+TPipeline *startPipeline(TCamStream *cs, const char color[3], int w, int h,
+                         TPipeResultFn fn, void *ctx) {
+    static void *(*const stage_fn[PIPE_STAGES])(void *) = { captureStage, decodeStage, detectStage };
+    TPipeline *pl;
+    int i;
+
+    pl = (TPipeline *)calloc(1, sizeof(TPipeline));
+    if (pl == NULL) return NULL;
+    pl->frames = createFramePool(PIPE_FRAMES, w, h, 3);
+    if (pl->frames == NULL) {
+        free(pl);
+        return NULL;
+    }
+    pl->cs = cs;
+    memcpy(pl->color, color, 3);
+    pl->fn = fn;
+    pl->ctx = ctx;
+    pthread_mutex_init(&pl->freeLock, NULL);
+    for (i = 0; i < PIPE_ITEMS; i++) {
+        pl->free[pl->numFree++] = &pl->items[i];
+    }
+    for (i = 0; i < PIPE_STAGES; i++) {
+        sem_init(&pl->queue[i].items, 0, 0);
+    }
+    pl->start = monoTime();
+    for (i = PIPE_STAGES - 1; i >= 0; i--) {
+        if (pthread_create(&pl->thread[i], NULL, stage_fn[i], pl)) {
+            // stop the stages already running behind this one
+            __atomic_store_n(&pl->quit, 1, __ATOMIC_RELEASE);
+            while (++i < PIPE_STAGES) {
+                sem_post(&pl->queue[i].items);
+                pthread_join(pl->thread[i], NULL);
+            }
+            destroyFramePool(pl->frames);
+            free(pl);
+            return NULL;
+        }
+    }
+    return pl;
+}
+
+// Function to check whether all frames of a finished source are through.
+int pipelineDone(TPipeline *pl) {
+    return __atomic_load_n(&pl->done[PIPE_DETECT], __ATOMIC_ACQUIRE);
+}
+
+// Function to take a snapshot of the statistics.
+void getPipelineStats(TPipeline *pl, TPipeStats *st) {
+    int s;
+
+    for (s = 0; s < PIPE_STAGES; s++) {
+        st->stage[s].frames = __atomic_load_n(&pl->stats[s].frames, __ATOMIC_RELAXED);
+        st->stage[s].dropped = __atomic_load_n(&pl->stats[s].dropped, __ATOMIC_RELAXED);
+        st->stage[s].busy = __atomic_load_n(&pl->busyNs[s], __ATOMIC_RELAXED) * 1e-9;
+        st->stage[s].maxDepth = __atomic_load_n(&pl->stats[s].maxDepth, __ATOMIC_RELAXED);
+        st->stage[s].depth = s == PIPE_CAPTURE ? 0 :
+            (int)(__atomic_load_n(&pl->queue[s].tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&pl->queue[s].head, __ATOMIC_ACQUIRE));
+    }
+    st->elapsed = monoTime() - pl->start;
+}
+
+// Function to set priority and CPU affinity of the stage threads.
+int setPipelineRealtime(TPipeline *pl, int prio, unsigned long cpus) {
+    int i, res = RT_FIFO | RT_PINNED;
+
+    for (i = 0; i < PIPE_STAGES; i++) {
+        res &= setThreadRealtime(pl->thread[i], prio, cpus);
+    }
+    if (prio <= 0) res &= ~RT_FIFO;
+    if (cpus == 0) res &= ~RT_PINNED;
+    return res;
+}
+
+// Function to stop the stage threads and free the pipeline.
+void stopPipeline(TPipeline *pl) {
+    TPipeItem *it;
+    int i;
+
+    __atomic_store_n(&pl->quit, 1, __ATOMIC_RELEASE);
+    for (i = 0; i < PIPE_STAGES; i++) {
+        sem_post(&pl->queue[i].items);
+        pthread_join(pl->thread[i], NULL);
+    }
+    for (i = 1; i < PIPE_STAGES; i++) {
+        while ((it = queuePop(&pl->queue[i])) != NULL) putItem(pl, it);
+        sem_destroy(&pl->queue[i].items);
+    }
+    sem_destroy(&pl->queue[0].items);
+    for (i = 0; i < PIPE_ITEMS; i++) free(pl->items[i].jpeg);
+    pthread_mutex_destroy(&pl->freeLock);
+    destroyFramePool(pl->frames);
+    free(pl);
+}
@@ -0,0 +1,89 @@
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+//======================================================================
+//
+// Module that runs the camera processing as a pipeline of three threads:
+//
+//     capture  -->  decode  -->  detect  -->  result callback
+//
+// Stages are connected by bounded single-producer/single-consumer ring
+// buffers.  A full queue drops its oldest entry, so a slow stage never
+// stalls the ones in front of it and the result is always computed from
+// the freshest frame that made it through.
+//
+// The detect stage follows the blob with followSearchBlob(), which mostly
+// searches a small window around the last one found.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include "detect_blob.h"
+#include "camera_stream.h"
+
+// Pipeline stages
+#define PIPE_CAPTURE 0
+#define PIPE_DECODE  1
+#define PIPE_DETECT  2
+#define PIPE_STAGES  3
+
+// Capacity of the queue in front of the decode and detect stage
+#define PIPE_QUEUE_LEN 2
+
+// Blobs below this size (pixels) are noise, they are neither reported nor followed
+#define PIPE_MIN_BLOB 8
+
+// Handle of a running pipeline
+typedef struct Pipeline TPipeline;
+
+// Called by the detect stage for every processed frame; t is the time the
+// frame was captured (CLOCK_MONOTONIC seconds).
+// blob->pimg is valid during the call only (use retainFrame() to keep it).
+typedef void (*TPipeResultFn)(void *ctx, const TBlobSearch *blob, unsigned long seq, double t);
+
+// Statistics of one stage
+typedef struct PipeStageStats {
+  unsigned long frames;   // frames completed by the stage
+  unsigned long dropped;  // frames dropped on the way into the stage
+  double busy;            // seconds spent working
+  int depth;              // current depth of the input queue
+  int maxDepth;           // largest depth seen on the input queue
+} TPipeStageStats;
+
+// Statistics of the whole pipeline
+typedef struct PipeStats {
+  TPipeStageStats stage[PIPE_STAGES];
+  double elapsed;         // seconds since startPipeline()
+} TPipeStats;
+
+
+//======================================================================
+// startPipeline():
+// Start the three stage threads reading frames from cs and searching them
+// for the largest blob of the given color.  Frames up to w x h pixels are
+// decoded into a frame pool; larger ones are dropped.  Returns NULL on
+// failure.
+TPipeline *startPipeline(TCamStream *cs, const char color[3], int w, int h,
+                         TPipeResultFn fn, void *ctx);
+
+// pipelineDone():
+// Returns non-zero once the frame source has ended and all frames are through.
+int pipelineDone(TPipeline *pl);
+
+// getPipelineStats():
+// Take a snapshot of the per-stage statistics.
+void getPipelineStats(TPipeline *pl, TPipeStats *st);
+
+// setPipelineRealtime():
+// Apply setThreadRealtime() (see periodic.h) to all stage threads.
+// Returns the RT_* flags that succeeded for every stage.
+int setPipelineRealtime(TPipeline *pl, int prio, unsigned long cpus);
+
+// stopPipeline():
+// Stop and join the stage threads and free the pipeline (not the stream).
+void stopPipeline(TPipeline *pl);
+
+
+#endif /* _PIPELINE_H_ */
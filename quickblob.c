@@ -1,15 +1,88 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
 
 #include "quickblob.h"
 
-// Structure for managing a list of blobs during image processing
-struct blob_list {
-    struct blob* head;           // Head of the blob list
-    int length;                  // Number of blobs allocated
-    struct blob** empties;       // Stack of unused blob pointers
-    int empty_i;                 // Index of the top of the empty stack
+// Run scanners compiled in (define QUICKBLOB_NO_SIMD for none but the portable
+// ones).  The word scanner needs a little-endian target, the SIMD ones start
+// with a word probe.  NEON needs -mfpu=neon on 32-bit ARM.  AVX2 is compiled
+// for any x86 build with SSE2, but only runs if the build has -mavx2 or through
+// quickblob_run_end() on a CPU that has it.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define QB_SCAN_WORDS
+#endif
+#if !defined(QUICKBLOB_NO_SIMD) && defined(QB_SCAN_WORDS) && \
+    (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define QB_SCAN_SSE2
+#define QB_SCAN_AVX2
+#endif
+#if !defined(QUICKBLOB_NO_SIMD) && defined(QB_SCAN_WORDS) && \
+    (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define QB_SCAN_NEON
+#endif
+
+// Run scanner of the labelling loop, picked at build time
+#if defined(QB_SCAN_AVX2) && defined(__AVX2__)
+#define QB_SCAN QUICKBLOB_SCAN_AVX2
+#elif defined(QB_SCAN_SSE2)
+#define QB_SCAN QUICKBLOB_SCAN_SSE2
+#elif defined(QB_SCAN_NEON)
+#define QB_SCAN QUICKBLOB_SCAN_NEON
+#elif defined(QB_SCAN_WORDS)
+#define QB_SCAN QUICKBLOB_SCAN_WORDS
+#else
+#define QB_SCAN QUICKBLOB_SCAN_BYTES
+#endif
+
+// A run on the first or last row of a band, kept for seam merging
+struct seam_seg {
+    int x1, x2;
+    int color;
+    int label;                   // band-local seam label
+};
+
+// One horizontal slice of the frame, scanned by one thread of the pool
+struct band {
+    struct band_pool* pool;
+    struct stream_state stream;  // private row buffer
+    struct blob_list blist;      // private blob pool
+    int y0, y1;                  // rows [y0, y1) of this band
+    int cap_w;                   // width the buffers below are sized for
+    struct blob* done;           // finished blobs, in completion order
+    int done_n, done_cap;
+    struct seam_seg* top;        // runs of row y0
+    int top_n;
+    struct seam_seg* bottom;     // runs of row y1-1
+    int bottom_n;
+    int* parent;                 // union-find over seam labels
+    int* label_done;             // index into done for each root label
+    int labels;
+    int failed;                  // a finished blob could not be stored
+};
+
+// Worker threads plus the per-frame merge scratch of the parallel engine
+struct band_pool {
+    int threads;
+    struct band* bands;
+    pthread_t* workers;
+    pthread_mutex_t lock;
+    pthread_cond_t go;
+    pthread_cond_t finished;
+    unsigned int generation;     // bumped once per dispatched frame
+    int active;                  // bands used by the current frame
+    int pending;                 // workers still scanning
+    int quit;
+    struct extractor* ex;
+    void* user_struct;
+    struct blob** flat;          // all finished blobs of a frame
+    int* parent;                 // union-find over flat
+    int flat_cap;
 };
 
 // Resets a blob structure to its initial state
@@ -26,18 +99,33 @@ static void blank(struct blob* b) {
     b->center_x = 0.0;
     b->center_y = 0.0;
     b->bb_x1 = b->bb_y1 = b->bb_x2 = b->bb_y2 = -1;
+    b->sum_x = 0;
+    b->sum_y = 0;
+    b->sum_xx = 0;
+    b->sum_yy = 0;
+    b->sum_xy = 0;
+    b->orientation = 0.0;
+    b->eccentricity = 0.0;
+    b->major_axis = 0.0;
+    b->minor_axis = 0.0;
+    b->tag = -1;
 }
 
 // Initializes a stream for reading pixel data
-static int init_pixel_stream(void* user_struct, struct stream_state* stream) {
+// The row buffers are owned by the extractor and survive between frames
+static int init_pixel_stream(struct extractor* ex, void* user_struct) {
+    struct stream_state* stream = &ex->stream;
+    unsigned char* row = stream->row;
+    uint64_t* bits = stream->bits;
     memset(stream, 0, sizeof(struct stream_state));
-    if (init_pixel_stream_hook(user_struct, stream)) {
+    stream->row = row;
+    stream->bits = bits;
+    stream->packed = ex->input == QUICKBLOB_BITS;
+    if (ex->hooks.init_pixel_stream(user_struct, stream)) {
         return 1;
     }
-    stream->row = (unsigned char*) malloc(stream->w * sizeof(unsigned char));
-    if (!stream->row) {
-        return 1; // Memory allocation failure
-    }
+    stream->row = row;
+    stream->bits = bits;
     stream->x = 0;
     stream->y = -1;
     stream->wrap = 0;
@@ -45,21 +133,22 @@ static int init_pixel_stream(void* user_struct, struct stream_state* stream) {
 }
 
 // Cleans up resources used by a pixel stream
-static int close_pixel_stream(void* user_struct, struct stream_state* stream) {
-    close_pixel_stream_hook(user_struct, stream);
-    free(stream->row);
-    stream->row = NULL;
+static int close_pixel_stream(struct extractor* ex, void* user_struct) {
+    if (ex->hooks.close_pixel_stream) {
+        return ex->hooks.close_pixel_stream(user_struct, &ex->stream);
+    }
     return 0;
 }
 
 // Allocates memory for blobs in the blob list
 static int malloc_blobs(struct blob_list* blist) {
     blist->head = (struct blob*) malloc(blist->length * sizeof(struct blob));
-    if (!blist->head) {
-        return 1;
-    }
     blist->empties = (struct blob**) malloc(blist->length * sizeof(struct blob*));
-    if (!blist->empties) {
+    if (!blist->head || !blist->empties) {
+        free(blist->head);
+        free(blist->empties);
+        blist->head = NULL;
+        blist->empties = NULL;
         return 1;
     }
     return 0;
@@ -79,6 +168,18 @@ static int init_blobs(struct blob_list* blist) {
     return 0;
 }
 
+// Takes an unused blob from the pool
+static struct blob* empty_blob(struct blob_list* blist) {
+    blist->empty_i--;
+    return blist->empties[blist->empty_i];
+}
+
+// Returns a blob to the pool
+static void blob_reap(struct blob_list* blist, struct blob* b) {
+    blank(b);
+    blist->empties[blist->empty_i++] = b;
+}
+
 // Removes a blob from the linked list
 static void blob_unlink(struct blob* b2) {
     struct blob* b1 = b2->prev;
@@ -94,53 +195,222 @@ static void blob_unlink(struct blob* b2) {
     b2->sib_p = b2->sib_n = NULL;
 }
 
-// Inserts a blob into the sorted list
+// Inserts a blob into the list, which is sorted by x1
+// bl_start must not sort after b2 (the list head always qualifies)
 static void blob_insert(struct blob* bl_start, struct blob* b2) {
-    struct blob* b1 = bl_start->prev;
+    struct blob* b1 = bl_start;
     struct blob* b3;
-    while (b1->next) {
-        b3 = b1->next;
-        if (b1->x1 <= b2->x1 && b2->x1 <= b3->x1) {
-            b1->next = b2;
-            b2->prev = b1;
-            b2->next = b3;
-            b3->prev = b2;
-            return;
-        }
+    while (b1->next && b1->next->x1 <= b2->x1) {
         b1 = b1->next;
     }
+    b3 = b1->next;
     b1->next = b2;
     b2->prev = b1;
+    b2->next = b3;
+    if (b3) b3->prev = b2;
 }
 
 // Reads the next row of pixel data in the stream
-static int next_row(void* user_struct, struct stream_state* stream) {
-    if (stream->y >= stream->h) {
+static int next_row(struct extractor* ex, void* user_struct) {
+    struct stream_state* stream = &ex->stream;
+    if (stream->y + 1 >= stream->h) {
         return 1; // End of the stream
     }
     stream->wrap = 0;
     stream->x = 0;
     stream->y++;
-    return next_row_hook(user_struct, stream);
+    return ex->hooks.next_row(user_struct, stream);
 }
 
 // Reads the next frame in the stream
-static int next_frame(void* user_struct, struct stream_state* stream) {
+static int next_frame(struct extractor* ex, void* user_struct) {
+    struct stream_state* stream = &ex->stream;
     stream->wrap = 0;
     stream->x = 0;
     stream->y = -1;
-    return next_frame_hook(user_struct, stream);
+    return ex->hooks.next_frame(user_struct, stream);
+}
+
+// The run scanners below return the first position >= x in row[0..w) that is
+// not color (w if none).  Their steps return the same, or -1 with x moved past
+// the pixels they checked.
+static int run_end_bytes(const unsigned char* row, int x, int w, unsigned char color) {
+    while (x < w && row[x] == color) x++;
+    return x;
+}
+
+#if defined(QB_SCAN_WORDS)
+// eight pixels per step in a plain 64-bit register
+static inline int scan_words(const unsigned char* row, int* x, int w, unsigned char color, int once) {
+    uint64_t c8 = 0x0101010101010101ULL * color;
+    uint64_t m8;
+    while (*x + 8 <= w) {
+        memcpy(&m8, row + *x, 8);
+        m8 ^= c8;
+        if (m8) return *x + (__builtin_ctzll(m8) >> 3);
+        *x += 8;
+        if (once) break;
+    }
+    return -1;
+}
+
+static int run_end_words(const unsigned char* row, int x, int w, unsigned char color) {
+    int e = scan_words(row, &x, w, color, 0);
+    return e >= 0 ? e : run_end_bytes(row, x, w, color);
+}
+#endif
+
+#if defined(QB_SCAN_SSE2)
+static inline int scan_sse2(const unsigned char* row, int* x, int w, unsigned char color) {
+    __m128i c16 = _mm_set1_epi8((char)color);
+    unsigned int m16;
+    while (*x + 16 <= w) {
+        m16 = 0xFFFF ^ (unsigned int)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(row + *x)), c16));
+        if (m16) return *x + __builtin_ctz(m16);
+        *x += 16;
+    }
+    return -1;
+}
+
+// one 8-pixel probe first, most runs in noisy rows end within it
+static int run_end_sse2(const unsigned char* row, int x, int w, unsigned char color) {
+    int e = scan_words(row, &x, w, color, 1);
+    if (e < 0) e = scan_sse2(row, &x, w, color);
+    return e >= 0 ? e : run_end_words(row, x, w, color);
+}
+#endif
+
+#if defined(QB_SCAN_AVX2)
+__attribute__((target("avx2")))
+static inline int scan_avx2(const unsigned char* row, int* x, int w, unsigned char color) {
+    __m256i c32 = _mm256_set1_epi8((char)color);
+    unsigned int m32;
+    while (*x + 32 <= w) {
+        m32 = ~(unsigned int)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(row + *x)), c32));
+        if (m32) return *x + __builtin_ctz(m32);
+        *x += 32;
+    }
+    return -1;
+}
+
+__attribute__((target("avx2")))
+static int run_end_avx2(const unsigned char* row, int x, int w, unsigned char color) {
+    int e = scan_words(row, &x, w, color, 1);
+    if (e < 0) e = scan_avx2(row, &x, w, color);
+    if (e < 0) e = scan_sse2(row, &x, w, color);
+    return e >= 0 ? e : run_end_words(row, x, w, color);
+}
+#endif
+
+#if defined(QB_SCAN_NEON)
+static inline int scan_neon(const unsigned char* row, int* x, int w, unsigned char color) {
+    uint8x16_t c16 = vdupq_n_u8(color);
+    uint64_t m16;
+    while (*x + 16 <= w) {
+        // narrow the byte mask to one nibble per pixel
+        uint8x16_t eq = vceqq_u8(vld1q_u8(row + *x), c16);
+        m16 = ~vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (m16) return *x + (__builtin_ctzll(m16) >> 2);
+        *x += 16;
+    }
+    return -1;
+}
+
+static int run_end_neon(const unsigned char* row, int x, int w, unsigned char color) {
+    int e = scan_words(row, &x, w, color, 1);
+    if (e < 0) e = scan_neon(row, &x, w, color);
+    return e >= 0 ? e : run_end_words(row, x, w, color);
+}
+#endif
+
+// The scanner of the labelling loop
+static inline int run_end(const unsigned char* row, int x, int w, unsigned char color) {
+#if QB_SCAN == QUICKBLOB_SCAN_AVX2
+    return run_end_avx2(row, x, w, color);
+#elif QB_SCAN == QUICKBLOB_SCAN_SSE2
+    return run_end_sse2(row, x, w, color);
+#elif QB_SCAN == QUICKBLOB_SCAN_NEON
+    return run_end_neon(row, x, w, color);
+#elif QB_SCAN == QUICKBLOB_SCAN_WORDS
+    return run_end_words(row, x, w, color);
+#else
+    return run_end_bytes(row, x, w, color);
+#endif
+}
+
+int quickblob_scanner(void) {
+    return QB_SCAN;
+}
+
+int quickblob_run_end(int scanner, const unsigned char* row, int x, int w, unsigned char color) {
+    switch (scanner) {
+    case QUICKBLOB_SCAN_BYTES:
+        return run_end_bytes(row, x, w, color);
+#if defined(QB_SCAN_WORDS)
+    case QUICKBLOB_SCAN_WORDS:
+        return run_end_words(row, x, w, color);
+#endif
+#if defined(QB_SCAN_SSE2)
+    case QUICKBLOB_SCAN_SSE2:
+        return run_end_sse2(row, x, w, color);
+#endif
+#if defined(QB_SCAN_AVX2)
+    case QUICKBLOB_SCAN_AVX2:
+        return __builtin_cpu_supports("avx2") ? run_end_avx2(row, x, w, color) : -1;
+#endif
+#if defined(QB_SCAN_NEON)
+    case QUICKBLOB_SCAN_NEON:
+        return run_end_neon(row, x, w, color);
+#endif
+    }
+    return -1;
+}
+
+// Returns the first position >= x in the packed row [0..w) that is not color (w if none)
+// XOR with the run's color clears its pixels, so the end is the lowest bit still set
+static int run_end_bits(const uint64_t* bits, int x, int w, int color) {
+    uint64_t flip = color ? ~0ULL : 0;
+    uint64_t m;
+    if (x >= w) return w;
+    m = (bits[x >> 6] ^ flip) >> (x & 63);
+    if (m) {
+        x += __builtin_ctzll(m);
+        return x < w ? x : w;
+    }
+    for (x = (x | 63) + 1; x < w; x += 64) {
+        m = bits[x >> 6] ^ flip;
+        if (m) {
+            x += __builtin_ctzll(m);
+            return x < w ? x : w;
+        }
+    }
+    return w;
+}
+
+// Finds the run starting at position x of the current row
+// Returns where it ends, its color goes to *color
+static int next_run(const struct stream_state* stream, int x, int* color) {
+    if (stream->packed) {
+        *color = (stream->bits[x >> 6] >> (x & 63)) & 1;
+        return run_end_bits(stream->bits, x + 1, stream->w, *color);
+    }
+    *color = stream->row[x];
+    return run_end(stream->row, x + 1, stream->w, *color);
 }
 
 // Scans a segment of pixels in the current row
+// Segments get frame columns, row[0] being column x0
 static int scan_segment(struct stream_state* stream, struct blob* b) {
     if (stream->wrap) return 1; // End of row
-    b->x1 = stream->x;
-    b->color = stream->row[stream->x];
-    while (stream->x < stream->w && b->color == stream->row[stream->x]) {
-        stream->x++;
+    b->x1 = stream->x0 + stream->x;
+    stream->x = next_run(stream, stream->x, &b->color);
+    b->x2 = stream->x0 + stream->x - 1;
+    b->y = stream->y;
+    if (stream->x >= stream->w) {
+        stream->wrap = 1;
     }
-    b->x2 = stream->x - 1;
     return 0;
 }
 
@@ -152,15 +422,49 @@ static void bbox_update(struct blob* b, int x1, int x2, int y1, int y2) {
     if (y2 > b->bb_y2) b->bb_y2 = y2;
 }
 
+// Sum of k*k for k = 0..n (0 for n = -1)
+static long long sum_squares(long long n) {
+    return n * (n + 1) * (2 * n + 1) / 6;
+}
+
 // Updates the properties of a blob with new pixel information
+// Coordinate sums are exact, so the order of merges cannot change the center
+// Runs are summed in closed form, there is no divide by a variable here
 static void blob_update(struct blob* b, int x1, int x2, int y) {
     int s2 = 1 + x2 - x1;
-    b->center_x = ((b->center_x * b->size) + (x1 + x2) * s2 / 2) / (b->size + s2);
-    b->center_y = ((b->center_y * b->size) + (y * s2)) / (b->size + s2);
+    long long sx = (long long)(x1 + x2) * s2 / 2;
+    b->sum_x += sx;
+    b->sum_y += (long long)y * s2;
+    b->sum_xx += sum_squares(x2) - sum_squares(x1 - 1);
+    b->sum_yy += (long long)y * y * s2;
+    b->sum_xy += sx * y;
     b->size += s2;
     bbox_update(b, x1, x2, y, y);
 }
 
+// Derives the center of a finished blob
+static void blob_finish(struct blob* b) {
+    b->center_x = (double)b->sum_x / b->size;
+    b->center_y = (double)b->sum_y / b->size;
+}
+
+// Derives the equivalent ellipse of a finished blob
+// Pixels count as unit squares (+1/12), so a single pixel has axes too
+static void blob_shape(struct blob* b) {
+    double n = b->size;
+    double mxx = b->sum_xx / n - b->center_x * b->center_x + 1.0 / 12;
+    double myy = b->sum_yy / n - b->center_y * b->center_y + 1.0 / 12;
+    double mxy = b->sum_xy / n - b->center_x * b->center_y;
+    double d = sqrt((mxx - myy) * (mxx - myy) / 4 + mxy * mxy);
+    double l1 = (mxx + myy) / 2 + d;
+    double l2 = (mxx + myy) / 2 - d;
+    if (l2 < 0) l2 = 0;
+    b->major_axis = 4 * sqrt(l1);
+    b->minor_axis = 4 * sqrt(l2);
+    b->eccentricity = sqrt(1 - l2 / l1);
+    b->orientation = 0.5 * atan2(2 * mxy, mxx - myy);
+}
+
 // Links sibling blobs into a single list
 static void sib_link(struct blob* b1, struct blob* b2) {
     while (b1->sib_p) b1 = b1->sib_p;
@@ -187,44 +491,923 @@ static void sib_link(struct blob* b1, struct blob* b2) {
     }
 }
 
-// Extracts blobs from an image stream
-int extract_image(void* user_struct) {
-    struct stream_state stream;
-    struct blob_list blist;
+// Links the new segment to every touching segment of the previous row
+// reach is 1 if segments touching only at a corner count (8-connectivity)
+static void sib_find(struct blob* bl_start, struct blob* b2, int reach) {
+    struct blob* b1;
+    for (b1 = bl_start; b1 && b1->x1 <= b2->x2 + reach; b1 = b1->next) {
+        if (b1->y != b2->y - 1 || b1->color != b2->color) continue;
+        if (b1->x2 + reach < b2->x1) continue;
+        sib_link(b1, b2);
+    }
+}
+
+// Folds the statistics of b2 into b1
+static void blob_merge(struct blob* b1, struct blob* b2) {
+    b1->size += b2->size;
+    b1->sum_x += b2->sum_x;
+    b1->sum_y += b2->sum_y;
+    b1->sum_xx += b2->sum_xx;
+    b1->sum_yy += b2->sum_yy;
+    b1->sum_xy += b2->sum_xy;
+    bbox_update(b1, b2->bb_x1, b2->bb_x2, b2->bb_y1, b2->bb_y2);
+}
+
+// Union-find with path halving, roots are the smallest index
+static int uf_find(int* parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+static void uf_union(int* parent, int a, int b) {
+    a = uf_find(parent, a);
+    b = uf_find(parent, b);
+    if (a < b) parent[b] = a;
+    if (b < a) parent[a] = b;
+}
+
+// Hands a finished blob to the user, or to the band's result list
+// The prune hook decides first, nothing is logged once it stopped the frame
+// Only logged blobs get their shape, pruned ones never need it
+static void blob_emit(struct extractor* ex, void* user_struct, struct band* bd, struct blob* b) {
+    struct blob* done;
+    int verdict = QUICKBLOB_KEEP;
+    if (!bd) {
+        if (ex->stopped) return;
+        blob_finish(b);
+        if (ex->hooks.prune_blob) verdict = ex->hooks.prune_blob(user_struct, b);
+        if (verdict == QUICKBLOB_DROP) return;
+        blob_shape(b);
+        ex->hooks.log_blob(user_struct, b);
+        ex->kept++;
+        if (verdict == QUICKBLOB_STOP) ex->stopped = 1;
+        return;
+    }
+    if (bd->failed) return;  // the frame is lost already
+    if (bd->done_n == bd->done_cap) {
+        done = (struct blob*) realloc(bd->done, 2 * (bd->done_cap + 16) * sizeof(struct blob));
+        if (!done) {
+            printf("Error allocating band results.\n");
+            bd->failed = 1;
+            return;
+        }
+        bd->done = done;
+        bd->done_cap = 2 * (bd->done_cap + 16);
+    }
+    if (b->tag >= 0) {
+        b->tag = uf_find(bd->parent, b->tag);
+        bd->label_done[b->tag] = bd->done_n;
+    }
+    bd->done[bd->done_n++] = *b;
+}
+
+// Retires every segment that did not continue onto row y
+// Segments with siblings are merged into them, the rest are complete blobs
+static void flush_old_blobs(struct extractor* ex, void* user_struct,
+                            struct blob_list* blist, struct band* bd, int y) {
+    struct blob* b = blist->head->next;
+    struct blob* next;
+    struct blob* s;
+    while (b) {
+        next = b->next;
+        if (b->y >= y) {
+            b = next;
+            continue;
+        }
+        // prefer a sibling that is still growing
+        s = b->sib_n;
+        while (s && s->y != y) s = s->sib_n;
+        if (!s) {
+            s = b->sib_p;
+            while (s && s->y != y) s = s->sib_p;
+        }
+        if (!s) s = b->sib_n ? b->sib_n : b->sib_p;
+        if (s) {
+            blob_merge(s, b);
+            if (b->tag >= 0) {
+                if (s->tag < 0) s->tag = b->tag;
+                else uf_union(bd->parent, s->tag, b->tag);
+            }
+        } else {
+            blob_emit(ex, user_struct, bd, b);
+        }
+        blob_unlink(b);
+        blob_reap(blist, b);
+        b = next;
+    }
+}
+
+// Splits the row in stream->row into segments and links them to the previous row
+static void scan_row(struct stream_state* stream, struct blob_list* blist, int reach) {
     struct blob* blob_now = NULL;
-    struct blob* blob_prev = NULL;
+    struct blob* blob_prev = blist->head;
+    while (!stream->wrap) {
+        blob_now = empty_blob(blist);
+        if (scan_segment(stream, blob_now)) {
+            blob_reap(blist, blob_now);
+            continue;
+        }
+        blob_update(blob_now, blob_now->x1, blob_now->x2, stream->y);
+        sib_find(blist->head->next, blob_now, reach);
+        blob_insert(blob_prev, blob_now);
+        blob_prev = blob_now;
+    }
+}
 
-    if (init_pixel_stream(user_struct, &stream)) {
-        printf("Error initializing pixel stream.\n");
+// Allocates the row buffers and a blob pool for frames of width w
+static int reserve_rows(struct stream_state* stream, struct blob_list* blist, int w) {
+    unsigned char* row = (unsigned char*) realloc(stream->row, w * sizeof(unsigned char));
+    uint64_t* bits;
+    if (!row) {
         return 1;
     }
-    blist.length = stream.w + 5;
-    if (malloc_blobs(&blist)) {
-        printf("Error allocating blob list.\n");
+    stream->row = row;
+    bits = (uint64_t*) realloc(stream->bits, ((w + 63) / 64) * sizeof(uint64_t));
+    if (!bits) {
+        return 1;
+    }
+    stream->bits = bits;
+    free(blist->head);
+    free(blist->empties);
+    // a row and its predecessor can each hold w segments
+    blist->length = 2 * w + 5;
+    if (malloc_blobs(blist)) {
+        return 1;
+    }
+    init_blobs(blist);
+    return 0;
+}
+
+// Makes sure the row buffer and blob pool fit a frame of width w
+static int extractor_reserve(struct extractor* ex, int w) {
+    if (w <= ex->max_w && ex->stream.row && ex->blist.head) {
+        return 0;
+    }
+    if (reserve_rows(&ex->stream, &ex->blist, w)) {
+        return 1;
+    }
+    ex->max_w = w;
+    return 0;
+}
+
+// Makes sure a band's buffers fit a frame of width w
+static int band_reserve(struct band* bd, int w) {
+    struct seam_seg* top;
+    struct seam_seg* bottom;
+    int* parent;
+    int* label_done;
+    if (w <= bd->cap_w) {
+        return 0;
+    }
+    if (reserve_rows(&bd->stream, &bd->blist, w)) {
+        return 1;
+    }
+    top = (struct seam_seg*) realloc(bd->top, w * sizeof(struct seam_seg));
+    if (top) bd->top = top;
+    bottom = (struct seam_seg*) realloc(bd->bottom, w * sizeof(struct seam_seg));
+    if (bottom) bd->bottom = bottom;
+    // at most w labels from the top row and w from the bottom row
+    parent = (int*) realloc(bd->parent, 2 * w * sizeof(int));
+    if (parent) bd->parent = parent;
+    label_done = (int*) realloc(bd->label_done, 2 * w * sizeof(int));
+    if (label_done) bd->label_done = label_done;
+    if (!top || !bottom || !parent || !label_done) {
         return 1;
     }
+    bd->cap_w = w;
+    return 0;
+}
+
+static void band_free(struct band* bd) {
+    free(bd->stream.row);
+    free(bd->stream.bits);
+    free(bd->blist.head);
+    free(bd->blist.empties);
+    free(bd->done);
+    free(bd->top);
+    free(bd->bottom);
+    free(bd->parent);
+    free(bd->label_done);
+    memset(bd, 0, sizeof(struct band));
+}
 
-    while (!next_frame(user_struct, &stream)) {
-        init_blobs(&blist);
-        while (!next_row(user_struct, &stream)) {
-            blob_prev = blist.head->next;
-            while (!stream.wrap) {
-                blob_now = empty_blob(&blist);
-                if (scan_segment(&stream, blob_now)) {
-                    blob_reap(&blist, blob_now);
-                    continue;
-                }
-                blob_update(blob_now, blob_now->x1, blob_now->x2, stream.y);
-                sib_find(blist.head->next, blob_now);
-                blob_insert(blob_prev, blob_now);
-                blob_prev = blob_now;
+// Gives a run on a seam row its own label
+static void seam_record(struct band* bd, struct seam_seg* seg, struct blob* b) {
+    if (b->tag < 0) {
+        b->tag = bd->labels;
+        bd->parent[bd->labels] = bd->labels;
+        bd->labels++;
+    }
+    seg->x1 = b->x1;
+    seg->x2 = b->x2;
+    seg->color = b->color;
+    seg->label = b->tag;
+}
+
+// Runs the serial engine over rows [y0, y1) of a band
+// Blobs touching the first or last row are labelled for the seam merge
+static void band_run(struct band* bd) {
+    struct extractor* ex = bd->pool->ex;
+    void* user_struct = bd->pool->user_struct;
+    struct stream_state* stream = &bd->stream;
+    struct blob* b;
+    int y;
+
+    bd->done_n = 0;
+    bd->top_n = 0;
+    bd->bottom_n = 0;
+    bd->labels = 0;
+    bd->failed = 0;
+    stream->w = ex->stream.w;
+    stream->h = ex->stream.h;
+    stream->x0 = 0;
+    stream->packed = ex->stream.packed;
+    stream->handle = ex->stream.handle;
+    for (y = bd->y0; y < bd->y1; y++) {
+        stream->x = 0;
+        stream->y = y;
+        stream->wrap = 0;
+        if (ex->hooks.next_row(user_struct, stream)) {
+            break;
+        }
+        scan_row(stream, &bd->blist, ex->connectivity == 8);
+        if (y == bd->y0) {
+            for (b = bd->blist.head->next; b; b = b->next) {
+                seam_record(bd, &bd->top[bd->top_n++], b);
+            }
+        }
+        if (y == bd->y1 - 1) {
+            for (b = bd->blist.head->next; b; b = b->next) {
+                if (b->y == y) seam_record(bd, &bd->bottom[bd->bottom_n++], b);
             }
-            flush_old_blobs(user_struct, &blist, stream.y);
+        }
+        flush_old_blobs(ex, user_struct, &bd->blist, bd, y);
+    }
+    flush_old_blobs(ex, user_struct, &bd->blist, bd, y + 1);
+}
+
+// Worker thread: scans its band every time a frame is dispatched
+static void* band_worker(void* arg) {
+    struct band* bd = (struct band*) arg;
+    struct band_pool* pool = bd->pool;
+    int index = bd - pool->bands;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (pool->generation == seen && !pool->quit) {
+            pthread_cond_wait(&pool->go, &pool->lock);
+        }
+        if (pool->quit) break;
+        seen = pool->generation;
+        if (index >= pool->active) continue;
+        pthread_mutex_unlock(&pool->lock);
+        band_run(bd);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->finished);
         }
     }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
 
-    close_pixel_stream(user_struct, &stream);
-    free(blist.head);
-    free(blist.empties);
+static void pool_free(struct band_pool* pool) {
+    int i;
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->go);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 1; i < pool->threads; i++) {
+        if (pool->workers[i]) pthread_join(pool->workers[i], NULL);
+    }
+    for (i = 0; i < pool->threads; i++) {
+        band_free(&pool->bands[i]);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->go);
+    pthread_cond_destroy(&pool->finished);
+    free(pool->workers);
+    free(pool->bands);
+    free(pool->flat);
+    free(pool->parent);
+    free(pool);
+}
+
+static struct band_pool* pool_new(int threads) {
+    struct band_pool* pool = (struct band_pool*) calloc(1, sizeof(struct band_pool));
+    int i;
+    if (!pool) {
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->go, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    pool->threads = threads;
+    pool->bands = (struct band*) calloc(threads, sizeof(struct band));
+    pool->workers = (pthread_t*) calloc(threads, sizeof(pthread_t));
+    if (!pool->bands || !pool->workers) {
+        pool->threads = 0;
+        pool_free(pool);
+        return NULL;
+    }
+    for (i = 0; i < threads; i++) {
+        pool->bands[i].pool = pool;
+    }
+    // band 0 is scanned by the calling thread
+    for (i = 1; i < threads; i++) {
+        if (pthread_create(&pool->workers[i], NULL, band_worker, &pool->bands[i])) {
+            pool->workers[i] = 0;
+            pool_free(pool);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+// Joins blobs that touch across band seams and logs every finished blob
+// Output is identical to the serial engine, only the logging order differs
+// Returns 1 if the merge buffers could not be allocated, nothing is logged then
+static int bands_merge(struct extractor* ex, void* user_struct) {
+    struct band_pool* pool = ex->pool;
+    struct band* bd;
+    struct band* bn;
+    struct seam_seg* a;
+    struct seam_seg* c;
+    int i, j, m, n, k, total = 0, off = 0, off_next;
+    int reach = ex->connectivity == 8;
+    int* parent;
+    struct blob** flat;
+
+    for (k = 0; k < pool->active; k++) {
+        total += pool->bands[k].done_n;
+    }
+    if (total > pool->flat_cap) {
+        flat = (struct blob**) realloc(pool->flat, total * sizeof(struct blob*));
+        if (flat) pool->flat = flat;
+        parent = (int*) realloc(pool->parent, total * sizeof(int));
+        if (parent) pool->parent = parent;
+        if (!flat || !parent) {
+            printf("Error allocating seam merge buffers.\n");
+            return 1;
+        }
+        pool->flat_cap = total;
+    }
+    flat = pool->flat;
+    parent = pool->parent;
+    for (k = 0, n = 0; k < pool->active; k++) {
+        bd = &pool->bands[k];
+        for (i = 0; i < bd->done_n; i++, n++) {
+            flat[n] = &bd->done[i];
+            parent[n] = n;
+        }
+    }
+
+    // runs touching across a seam belong to the same blob, diagonally too with reach
+    for (k = 0; k + 1 < pool->active; k++) {
+        bd = &pool->bands[k];
+        bn = &pool->bands[k + 1];
+        off_next = off + bd->done_n;
+        // a run can touch several below it, and diagonally also the one the
+        // previous run ended on, so every run checks its whole window
+        j = 0;
+        for (i = 0; i < bd->bottom_n; i++) {
+            a = &bd->bottom[i];
+            while (j < bn->top_n && bn->top[j].x2 + reach < a->x1) j++;
+            for (m = j; m < bn->top_n && bn->top[m].x1 <= a->x2 + reach; m++) {
+                c = &bn->top[m];
+                if (a->color != c->color) continue;
+                uf_union(parent,
+                         off + bd->label_done[uf_find(bd->parent, a->label)],
+                         off_next + bn->label_done[uf_find(bn->parent, c->label)]);
+            }
+        }
+        off = off_next;
+    }
+
+    for (n = 0; n < total; n++) {
+        i = uf_find(parent, n);
+        if (i != n) blob_merge(flat[i], flat[n]);
+    }
+    for (n = 0; n < total; n++) {
+        if (parent[n] == n) blob_emit(ex, user_struct, NULL, flat[n]);
+    }
+    return 0;
+}
+
+// Scans one frame with the band pool
+// Returns 1 if a buffer could not be allocated, no blob of the frame is logged then
+static int bands_run_frame(struct extractor* ex, void* user_struct) {
+    struct band_pool* pool = ex->pool;
+    int h = ex->stream.h;
+    int k, active = pool->threads < h ? pool->threads : h;
+
+    for (k = 0; k < active; k++) {
+        if (band_reserve(&pool->bands[k], ex->stream.w)) {
+            printf("Error allocating band buffers.\n");
+            return 1;
+        }
+        pool->bands[k].y0 = (int)((long long)h * k / active);
+        pool->bands[k].y1 = (int)((long long)h * (k + 1) / active);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->ex = ex;
+    pool->user_struct = user_struct;
+    pool->active = active;
+    pool->pending = active - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->go);
+    pthread_mutex_unlock(&pool->lock);
+
+    band_run(&pool->bands[0]);
+    ex->pixels += (long long)ex->stream.w * h;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    for (k = 0; k < active; k++) {
+        if (pool->bands[k].failed) return 1;
+    }
+    return bands_merge(ex, user_struct);
+}
+
+// Runs of one row for the union-find engine, structure of arrays
+struct uf_rows {
+    int* x1;
+    int* x2;
+    int* color;
+    int* label;                  // root label once the row is finished
+    int* raw;                    // label before that, kept to free it
+    int n;
+};
+
+// Union-find engine: runs of two rows plus a pool of labels
+// Every label is a partial blob, its statistics live in the arrays below
+// A row holds at most w runs, so 2w + 2 labels are enough for any frame
+struct uf_engine {
+    int cap_w;                   // width the buffers are sized for
+    int cap;                     // labels in the pool
+    struct uf_rows rows[2];
+    struct uf_rows* prev;
+    struct uf_rows* cur;
+    int* parent;                 // -1 for a free label
+    int* size;
+    int* color;
+    int* last_y;                 // last row the label got a run on
+    int* emitted;                // root that was handed to blob_emit()
+    int* bb_x1;
+    int* bb_y1;
+    int* bb_x2;
+    int* bb_y2;
+    long long* sum_x;
+    long long* sum_y;
+    long long* sum_xx;
+    long long* sum_yy;
+    long long* sum_xy;
+    int* free_stack;
+    int free_n;
+    long bytes;                  // size of the block all arrays live in
+};
+
+// Puts every label back on the free stack and forgets both rows
+static void uf_reset(struct uf_engine* uf) {
+    int i;
+    for (i = 0; i < uf->cap; i++) {
+        uf->parent[i] = -1;
+        uf->free_stack[i] = uf->cap - 1 - i;
+    }
+    uf->free_n = uf->cap;
+    uf->rows[0].n = 0;
+    uf->rows[1].n = 0;
+    uf->prev = &uf->rows[0];
+    uf->cur = &uf->rows[1];
+}
+
+// Carves n elements of the given size out of the block at *p
+static void* uf_carve(char** p, size_t n, size_t size) {
+    void* a = *p;
+    *p += n * size;
+    return a;
+}
+
+// Allocates the engine for frames of width w, all arrays share one block
+static struct uf_engine* uf_new(int w) {
+    struct uf_engine* uf;
+    size_t cap = 2 * (size_t)w + 2;
+    size_t wide = 5 * cap * sizeof(long long);
+    size_t narrow = (10 * cap + 10 * (size_t)w) * sizeof(int);
+    char* p;
+    int k;
+    uf = (struct uf_engine*) malloc(sizeof(struct uf_engine) + wide + narrow);
+    if (!uf) {
+        return NULL;
+    }
+    p = (char*)(uf + 1);
+    // the long long arrays go first, they need the strictest alignment
+    uf->sum_x = (long long*) uf_carve(&p, cap, sizeof(long long));
+    uf->sum_y = (long long*) uf_carve(&p, cap, sizeof(long long));
+    uf->sum_xx = (long long*) uf_carve(&p, cap, sizeof(long long));
+    uf->sum_yy = (long long*) uf_carve(&p, cap, sizeof(long long));
+    uf->sum_xy = (long long*) uf_carve(&p, cap, sizeof(long long));
+    uf->parent = (int*) uf_carve(&p, cap, sizeof(int));
+    uf->size = (int*) uf_carve(&p, cap, sizeof(int));
+    uf->color = (int*) uf_carve(&p, cap, sizeof(int));
+    uf->last_y = (int*) uf_carve(&p, cap, sizeof(int));
+    uf->emitted = (int*) uf_carve(&p, cap, sizeof(int));
+    uf->bb_x1 = (int*) uf_carve(&p, cap, sizeof(int));
+    uf->bb_y1 = (int*) uf_carve(&p, cap, sizeof(int));
+    uf->bb_x2 = (int*) uf_carve(&p, cap, sizeof(int));
+    uf->bb_y2 = (int*) uf_carve(&p, cap, sizeof(int));
+    uf->free_stack = (int*) uf_carve(&p, cap, sizeof(int));
+    for (k = 0; k < 2; k++) {
+        uf->rows[k].x1 = (int*) uf_carve(&p, w, sizeof(int));
+        uf->rows[k].x2 = (int*) uf_carve(&p, w, sizeof(int));
+        uf->rows[k].color = (int*) uf_carve(&p, w, sizeof(int));
+        uf->rows[k].label = (int*) uf_carve(&p, w, sizeof(int));
+        uf->rows[k].raw = (int*) uf_carve(&p, w, sizeof(int));
+    }
+    uf->cap_w = w;
+    uf->cap = (int)cap;
+    uf->bytes = (long)(sizeof(struct uf_engine) + wide + narrow);
+    uf_reset(uf);
+    return uf;
+}
+
+// Takes a label off the free stack for a new partial blob
+static int uf_label(struct uf_engine* uf, int color) {
+    int l = uf->free_stack[--uf->free_n];
+    uf->parent[l] = l;
+    uf->size[l] = 0;
+    uf->color[l] = color;
+    uf->last_y[l] = -1;
+    uf->emitted[l] = 0;
+    uf->bb_x1[l] = uf->bb_y1[l] = uf->bb_x2[l] = uf->bb_y2[l] = -1;
+    uf->sum_x[l] = uf->sum_y[l] = 0;
+    uf->sum_xx[l] = uf->sum_yy[l] = uf->sum_xy[l] = 0;
+    return l;
+}
+
+static void uf_release(struct uf_engine* uf, int l) {
+    uf->parent[l] = -1;
+    uf->free_stack[uf->free_n++] = l;
+}
+
+// Adds a run to root label l, same sums as blob_update()
+static void uf_add_run(struct uf_engine* uf, int l, int x1, int x2, int y) {
+    int s2 = 1 + x2 - x1;
+    long long sx = (long long)(x1 + x2) * s2 / 2;
+    uf->sum_x[l] += sx;
+    uf->sum_y[l] += (long long)y * s2;
+    uf->sum_xx[l] += sum_squares(x2) - sum_squares(x1 - 1);
+    uf->sum_yy[l] += (long long)y * y * s2;
+    uf->sum_xy[l] += sx * y;
+    uf->size[l] += s2;
+    if (uf->bb_x1[l] < 0 || x1 < uf->bb_x1[l]) uf->bb_x1[l] = x1;
+    if (x2 > uf->bb_x2[l]) uf->bb_x2[l] = x2;
+    if (uf->bb_y1[l] < 0) uf->bb_y1[l] = y;
+    uf->bb_y2[l] = y;
+    uf->last_y[l] = y;
+}
+
+// Joins two root labels, the one with more pixels stays root
+// Returns the new root
+static int uf_join(struct uf_engine* uf, int a, int b) {
+    int t;
+    if (uf->size[a] < uf->size[b]) {
+        t = a;
+        a = b;
+        b = t;
+    }
+    uf->parent[b] = a;
+    uf->size[a] += uf->size[b];
+    uf->sum_x[a] += uf->sum_x[b];
+    uf->sum_y[a] += uf->sum_y[b];
+    uf->sum_xx[a] += uf->sum_xx[b];
+    uf->sum_yy[a] += uf->sum_yy[b];
+    uf->sum_xy[a] += uf->sum_xy[b];
+    if (uf->bb_x1[b] < uf->bb_x1[a]) uf->bb_x1[a] = uf->bb_x1[b];
+    if (uf->bb_x2[b] > uf->bb_x2[a]) uf->bb_x2[a] = uf->bb_x2[b];
+    if (uf->bb_y1[b] < uf->bb_y1[a]) uf->bb_y1[a] = uf->bb_y1[b];
+    if (uf->bb_y2[b] > uf->bb_y2[a]) uf->bb_y2[a] = uf->bb_y2[b];
+    if (uf->last_y[b] > uf->last_y[a]) uf->last_y[a] = uf->last_y[b];
+    return a;
+}
+
+// Hands the finished component of root label l to blob_emit()
+static void uf_emit(struct extractor* ex, void* user_struct, struct uf_engine* uf, int l) {
+    struct blob b;
+    blank(&b);
+    b.size = uf->size[l];
+    b.color = uf->color[l];
+    b.x1 = uf->bb_x1[l];
+    b.x2 = uf->bb_x2[l];
+    b.y = uf->bb_y2[l];
+    b.bb_x1 = uf->bb_x1[l];
+    b.bb_y1 = uf->bb_y1[l];
+    b.bb_x2 = uf->bb_x2[l];
+    b.bb_y2 = uf->bb_y2[l];
+    b.sum_x = uf->sum_x[l];
+    b.sum_y = uf->sum_y[l];
+    b.sum_xx = uf->sum_xx[l];
+    b.sum_yy = uf->sum_yy[l];
+    b.sum_xy = uf->sum_xy[l];
+    uf->emitted[l] = 1;
+    blob_emit(ex, user_struct, NULL, &b);
+}
+
+// Emits the components that ended on the previous row and frees the labels
+// no run refers to anymore, then row y becomes the previous row
+static void uf_retire(struct extractor* ex, void* user_struct, struct uf_engine* uf, int y) {
+    struct uf_rows* prev = uf->prev;
+    struct uf_rows* cur = uf->cur;
+    int i, l;
+    for (i = 0; i < prev->n; i++) {
+        l = uf_find(uf->parent, prev->label[i]);
+        if (uf->last_y[l] < y && !uf->emitted[l]) uf_emit(ex, user_struct, uf, l);
+    }
+    for (i = 0; i < cur->n; i++) {
+        cur->raw[i] = cur->label[i];
+        cur->label[i] = uf_find(uf->parent, cur->label[i]);
+    }
+    // all finds are done, labels nobody refers to can go now
+    for (i = 0; i < cur->n; i++) {
+        if (cur->raw[i] != cur->label[i] && uf->parent[cur->raw[i]] >= 0) {
+            uf_release(uf, cur->raw[i]);
+        }
+    }
+    for (i = 0; i < prev->n; i++) {
+        l = prev->label[i];
+        if (uf->parent[l] >= 0 && (uf->parent[l] != l || uf->emitted[l])) uf_release(uf, l);
+    }
+    uf->prev = cur;
+    uf->cur = prev;
+}
+
+// Splits the row in stream->row into runs and labels them
+// Each run joins the labels of the touching runs of the previous row
+static void uf_scan_row(struct extractor* ex, void* user_struct, struct uf_engine* uf) {
+    struct stream_state* stream = &ex->stream;
+    struct uf_rows* prev = uf->prev;
+    struct uf_rows* cur = uf->cur;
+    int reach = ex->connectivity == 8;
+    int x = 0, e, c, i, j = 0, k, l, r;
+    cur->n = 0;
+    while (x < stream->w) {
+        e = next_run(stream, x, &c);
+        i = cur->n++;
+        cur->x1[i] = stream->x0 + x;
+        cur->x2[i] = stream->x0 + e - 1;
+        cur->color[i] = c;
+        x = e;
+    }
+    for (i = 0; i < cur->n; i++) {
+        // both rows are sorted, runs left of this one are done for good
+        while (j < prev->n && prev->x2[j] + reach < cur->x1[i]) j++;
+        l = -1;
+        for (k = j; k < prev->n && prev->x1[k] <= cur->x2[i] + reach; k++) {
+            if (prev->color[k] != cur->color[i]) continue;
+            r = uf_find(uf->parent, prev->label[k]);
+            if (l < 0) l = r;
+            else if (r != l) l = uf_join(uf, l, r);
+        }
+        if (l < 0) l = uf_label(uf, cur->color[i]);
+        cur->label[i] = l;
+        uf_add_run(uf, l, cur->x1[i], cur->x2[i], stream->y);
+    }
+    uf_retire(ex, user_struct, uf, stream->y);
+}
+
+// Emits whatever is left after the last row of a window
+static void uf_flush(struct extractor* ex, void* user_struct, struct uf_engine* uf) {
+    uf->cur->n = 0;
+    uf_retire(ex, user_struct, uf, ex->stream.y + 1);
+}
+
+int extractor_init(struct extractor* ex, const struct quickblob_hooks* hooks, int max_w) {
+    memset(ex, 0, sizeof(struct extractor));
+    ex->hooks = *hooks;
+    ex->connectivity = 4;
+    if (max_w > 0 && extractor_reserve(ex, max_w)) {
+        extractor_free(ex);
+        return 1;
+    }
+    return 0;
+}
+
+int extractor_set_threads(struct extractor* ex, int threads) {
+    if (ex->pool) {
+        pool_free(ex->pool);
+        ex->pool = NULL;
+    }
+    if (threads <= 1) {
+        return 0;
+    }
+    ex->pool = pool_new(threads);
+    return ex->pool ? 0 : 1;
+}
+
+// Tells if two windows overlap or touch, a blob could then cross between them
+static int rois_touch(const struct roi* a, const struct roi* b) {
+    return a->x1 <= b->x2 + 1 && b->x1 <= a->x2 + 1 &&
+           a->y1 <= b->y2 + 1 && b->y1 <= a->y2 + 1;
+}
+
+int extractor_set_rois(struct extractor* ex, const struct roi* rois, int n, int fallback) {
+    struct roi* a;
+    struct roi* b;
+    int i, j, merged;
+    if (n < 0 || n > QUICKBLOB_MAX_ROI) {
+        return 1;
+    }
+    ex->roi_n = 0;
+    for (i = 0; i < n; i++) {
+        if (rois[i].x2 < rois[i].x1 || rois[i].y2 < rois[i].y1) continue;
+        ex->roi[ex->roi_n++] = rois[i];
+    }
+    // a grown window can touch one that was checked already, so repeat
+    do {
+        merged = 0;
+        for (i = 0; i < ex->roi_n; i++) {
+            for (j = i + 1; j < ex->roi_n; j++) {
+                a = &ex->roi[i];
+                b = &ex->roi[j];
+                if (!rois_touch(a, b)) continue;
+                if (b->x1 < a->x1) a->x1 = b->x1;
+                if (b->y1 < a->y1) a->y1 = b->y1;
+                if (b->x2 > a->x2) a->x2 = b->x2;
+                if (b->y2 > a->y2) a->y2 = b->y2;
+                *b = ex->roi[--ex->roi_n];
+                merged = 1;
+                j--;
+            }
+        }
+    } while (merged);
+    ex->roi_fallback = fallback;
     return 0;
 }
+
+int extractor_set_engine(struct extractor* ex, int engine, int connectivity) {
+    if (engine != QUICKBLOB_LISTS && engine != QUICKBLOB_UNION_FIND) {
+        return 1;
+    }
+    if (connectivity != 4 && connectivity != 8) {
+        return 1;
+    }
+    ex->engine = engine;
+    ex->connectivity = connectivity;
+    return 0;
+}
+
+int extractor_set_input(struct extractor* ex, int input) {
+    if (input != QUICKBLOB_BYTES && input != QUICKBLOB_BITS) {
+        return 1;
+    }
+    ex->input = input;
+    return 0;
+}
+
+long extractor_bytes(const struct extractor* ex) {
+    long bytes = ex->max_w + (long)((ex->max_w + 63) / 64) * sizeof(uint64_t);
+    if (ex->engine == QUICKBLOB_UNION_FIND && ex->uf) {
+        return bytes + ex->uf->bytes;
+    }
+    return bytes + (long)ex->blist.length * (sizeof(struct blob) + sizeof(struct blob*));
+}
+
+void extractor_free(struct extractor* ex) {
+    if (ex->pool) {
+        pool_free(ex->pool);
+        ex->pool = NULL;
+    }
+    free(ex->uf);
+    ex->uf = NULL;
+    free(ex->stream.row);
+    free(ex->stream.bits);
+    free(ex->blist.head);
+    free(ex->blist.empties);
+    ex->stream.row = NULL;
+    ex->stream.bits = NULL;
+    ex->blist.head = NULL;
+    ex->blist.empties = NULL;
+    ex->max_w = 0;
+}
+
+// Runs the serial engine over columns [x1, x2] of rows [y1, y2]
+// A stopped frame leaves blobs behind, the pool or the labels are reset for the next window
+static void scan_window(struct extractor* ex, void* user_struct, int x1, int y1, int x2, int y2) {
+    struct stream_state* stream = &ex->stream;
+    int w = stream->w;
+    int h = stream->h;
+    stream->x0 = x1;
+    stream->w = x2 - x1 + 1;
+    stream->h = y2 + 1;
+    stream->y = y1 - 1;
+    while (!ex->stopped && !next_row(ex, user_struct)) {
+        if (ex->engine == QUICKBLOB_UNION_FIND) {
+            uf_scan_row(ex, user_struct, ex->uf);
+        } else {
+            scan_row(stream, &ex->blist, ex->connectivity == 8);
+            flush_old_blobs(ex, user_struct, &ex->blist, NULL, stream->y);
+        }
+        ex->pixels += stream->w;
+    }
+    if (ex->stopped) {
+        if (ex->engine == QUICKBLOB_UNION_FIND) uf_reset(ex->uf);
+        else init_blobs(&ex->blist);
+    } else if (ex->engine == QUICKBLOB_UNION_FIND) {
+        uf_flush(ex, user_struct, ex->uf);
+    } else {
+        flush_old_blobs(ex, user_struct, &ex->blist, NULL, stream->y + 1);
+    }
+    stream->x0 = 0;
+    stream->w = w;
+    stream->h = h;
+}
+
+// Scans the windows of a frame, clipped to it
+// Returns 1 if the frame is done, 0 if it still has to be scanned whole
+static int scan_rois(struct extractor* ex, void* user_struct) {
+    struct roi* r;
+    int i, x1, y1, x2, y2;
+    for (i = 0; i < ex->roi_n && !ex->stopped; i++) {
+        r = &ex->roi[i];
+        x1 = r->x1 > 0 ? r->x1 : 0;
+        y1 = r->y1 > 0 ? r->y1 : 0;
+        x2 = r->x2 < ex->stream.w ? r->x2 : ex->stream.w - 1;
+        y2 = r->y2 < ex->stream.h ? r->y2 : ex->stream.h - 1;
+        if (x1 > x2 || y1 > y2) continue;
+        scan_window(ex, user_struct, x1, y1, x2, y2);
+    }
+    return ex->kept > 0 || ex->stopped || !ex->roi_fallback;
+}
+
+// Extracts blobs from an image stream
+// Every frame ends with all blobs reaped, so the pool needs no re-init
+int extractor_run(struct extractor* ex, void* user_struct) {
+    struct stream_state* stream = &ex->stream;
+    int status = 0;
+    ex->pixels = 0;
+
+    if (init_pixel_stream(ex, user_struct)) {
+        printf("Error initializing pixel stream.\n");
+        return 1;
+    }
+    if (extractor_reserve(ex, stream->w)) {
+        printf("Error allocating blob list.\n");
+        close_pixel_stream(ex, user_struct);
+        return 1;
+    }
+    if (ex->engine == QUICKBLOB_UNION_FIND && (!ex->uf || ex->uf->cap_w < stream->w)) {
+        free(ex->uf);
+        ex->uf = uf_new(ex->max_w);
+        if (!ex->uf) {
+            printf("Error allocating union-find labels.\n");
+            close_pixel_stream(ex, user_struct);
+            return 1;
+        }
+    }
+
+    while (!next_frame(ex, user_struct)) {
+        ex->kept = 0;
+        ex->stopped = 0;
+        if (ex->roi_n && scan_rois(ex, user_struct)) {
+            continue;
+        }
+        if (ex->pool) {
+            status = bands_run_frame(ex, user_struct);
+            if (status) break;
+            continue;
+        }
+        scan_window(ex, user_struct, 0, 0, stream->w - 1, stream->h - 1);
+    }
+
+    close_pixel_stream(ex, user_struct);
+    return status;
+}
+
+// Extracts blobs through the global hook functions
+int extract_image(void* user_struct) {
+    static const struct quickblob_hooks global_hooks = {
+        log_blob_hook,
+        init_pixel_stream_hook,
+        close_pixel_stream_hook,
+        next_row_hook,
+        next_frame_hook
+    };
+    struct extractor ex;
+    int status;
+
+    if (extractor_init(&ex, &global_hooks, 0)) {
+        return 1;
+    }
+    status = extractor_run(&ex, user_struct);
+    extractor_free(&ex);
+    return status;
+}
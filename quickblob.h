@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 // gcc -O2 -c quickblob.c -o quickblob.o
 // ar rvs quickblob.a quickblob.o
@@ -16,6 +17,46 @@ ABOUT
     blobs are assembled incrementally
     complete blobs are passed to log_blob_hook
     see more details in quickblob.c
+
+REENTRANT USE
+    struct extractor bundles the hooks, the blob pool and the row buffer
+    init it once with the largest frame width you expect
+    extractor_run() can then be called for every frame without mallocs
+    use one extractor per thread, they share no state
+
+PARALLEL USE
+    extractor_set_threads() splits every frame into horizontal bands
+    each band is scanned by its own thread, blobs are joined at the seams
+    results are identical to the serial engine, only the log order differs
+    next_row is then called concurrently, one stream_state per band
+    log_blob is still only called from the thread running extractor_run()
+    extract_image() is kept for the classic global-hook interface
+
+WINDOWS AND PRUNING
+    extractor_set_rois() restricts the scan to a few rectangles of the frame
+    rows are then requested for the columns of one window at a time
+    overlapping or touching windows are merged, blobs are clipped at the edges
+    when no blob survives the windows the whole frame can be scanned instead
+    the prune hook sees every finished blob before log_blob
+    it can drop the blob, or keep it and end the frame right there
+    windows are always scanned serially, they are small
+
+ENGINES
+    the default engine keeps the runs of two rows in a linked list
+    touching runs are chained as siblings and merged when a run ends
+    extractor_set_engine() can pick a union-find labeller instead
+    it keeps the runs of two rows in flat arrays and joins labels
+    the statistics live in flat per-label arrays, no list walking
+    both log the same blobs, pick whichever is faster for your images
+    either can join runs that only touch diagonally (8-connectivity)
+    the band engine always uses the lists, with the same connectivity
+
+PACKED ROWS
+    a mask with two values (0 and 1) can arrive packed, 64 pixels per word
+    extractor_set_input() switches next_row to filling stream->bits
+    runs are then found a word at a time, by XOR with the run's color
+    and counting the trailing zeros, instead of comparing bytes
+    every engine reads both inputs and logs the same blobs
 */
 
 /* some structures you'll be working with */
@@ -40,6 +81,20 @@ struct blob
     double center_y;
     // bounding box
     int bb_x1, bb_y1, bb_x2, bb_y2;
+    // exact coordinate sums, center_x/center_y are derived from these
+    long long sum_x;
+    long long sum_y;
+    // exact second-order sums, the shape below is derived from these
+    long long sum_xx;
+    long long sum_yy;
+    long long sum_xy;
+    // ellipse with the same second moments, set for logged blobs only
+    double orientation;  // major axis in radians from +x towards +y (rows grow down)
+    double eccentricity;  // 0 for a disc, towards 1 for a line
+    double major_axis;  // full axis lengths in pixels
+    double minor_axis;
+    // seam label of the parallel engine
+    int tag;
     // single linked list for tracking all old pixels
     // struct blob* old;
 };
@@ -49,11 +104,87 @@ struct stream_state
 // and reference in the handle pointer
 {
     int w, h, x, y;
+    int x0;  // first column of the row, non-zero while scanning a window
     int wrap;  // don't touch this
     unsigned char* row;
+    uint64_t* bits;  // packed row, bit i of bits[k] is pixel 64*k + i
+    int packed;  // next_row fills bits instead of row, see extractor_set_input()
     void* handle;
 };
 
+struct blob_list
+// pool of blobs, one extra slot is the list head
+{
+    struct blob* head;
+    int length;
+    struct blob** empties;
+    int empty_i;
+};
+
+struct quickblob_hooks
+// same contract as the *_hook functions below
+// close_pixel_stream and prune_blob may be NULL
+{
+    void (*log_blob)(void* user_struct, struct blob* b);
+    int (*init_pixel_stream)(void* user_struct, struct stream_state* stream);
+    int (*close_pixel_stream)(void* user_struct, struct stream_state* stream);
+    int (*next_row)(void* user_struct, struct stream_state* stream);
+    int (*next_frame)(void* user_struct, struct stream_state* stream);
+    int (*prune_blob)(void* user_struct, struct blob* b);
+};
+
+// most windows a frame can be restricted to
+#define QUICKBLOB_MAX_ROI 8
+
+struct roi
+// window of a frame, corners inclusive
+{
+    int x1, y1, x2, y2;
+};
+
+// verdicts of the prune_blob hook
+#define QUICKBLOB_KEEP 0  // log the blob
+#define QUICKBLOB_DROP 1  // forget it, it does not count as found
+#define QUICKBLOB_STOP 2  // log it and skip the rest of the frame
+
+// engines of extractor_set_engine()
+#define QUICKBLOB_LISTS 0  // sibling lists, the default
+#define QUICKBLOB_UNION_FIND 1  // run arrays and union-find labels
+
+// inputs of extractor_set_input()
+#define QUICKBLOB_BYTES 0  // one byte per pixel in stream->row, the default
+#define QUICKBLOB_BITS 1  // one bit per pixel in stream->bits, colors 0 and 1 only
+
+// run scanners of quickblob_run_end()
+#define QUICKBLOB_SCAN_BYTES 0  // byte by byte
+#define QUICKBLOB_SCAN_WORDS 1  // 8 pixels per step in a 64-bit word, portable
+#define QUICKBLOB_SCAN_SSE2 2  // 16 pixels per step
+#define QUICKBLOB_SCAN_AVX2 3  // 32 pixels per step
+#define QUICKBLOB_SCAN_NEON 4  // 16 pixels per step
+
+struct band_pool;  // private to quickblob.c
+struct uf_engine;  // private to quickblob.c
+
+struct extractor
+// everything one extraction needs, reused from frame to frame
+{
+    struct quickblob_hooks hooks;
+    struct stream_state stream;
+    struct blob_list blist;
+    int max_w;  // capacity of stream.row and blist
+    struct band_pool* pool;  // NULL for the serial engine
+    struct roi roi[QUICKBLOB_MAX_ROI];  // see extractor_set_rois()
+    int roi_n;  // 0 scans whole frames
+    int roi_fallback;  // rescan the whole frame when the windows log nothing
+    int kept;  // blobs logged in the current frame
+    int stopped;  // the prune hook ended the current frame
+    long long pixels;  // pixels scanned by the last extractor_run()
+    int engine;  // QUICKBLOB_LISTS or QUICKBLOB_UNION_FIND
+    int connectivity;  // 4 or 8
+    struct uf_engine* uf;  // buffers of the union-find engine, NULL until used
+    int input;  // QUICKBLOB_BYTES or QUICKBLOB_BITS
+};
+
 /* these are the functions you need to define
  * you get void pointer for passing around useful data */
 
@@ -74,6 +205,10 @@ int close_pixel_stream_hook(void* user_struct, struct stream_state* stream);
 
 int next_row_hook(void* user_struct, struct stream_state* stream);
 // load the (grayscale) row at stream->y into the (8 bit) stream->row array
+// or, if stream->packed is set, the 0/1 mask of it into stream->bits
+// (bits past stream->w are ignored)
+// with windows set, only stream->w pixels starting at column stream->x0
+// and rows may be skipped or requested again for the next window
 // return status (0 for success)
 
 int next_frame_hook(void* user_struct, struct stream_state* stream);
@@ -83,5 +218,51 @@ int next_frame_hook(void* user_struct, struct stream_state* stream);
 /* callable functions */
 
 int extract_image(void* user_struct);
+// one-shot extraction through the global hooks above
+// allocates and frees its buffers on every call
+
+int extractor_init(struct extractor* ex, const struct quickblob_hooks* hooks, int max_w);
+// preallocate for frames up to max_w pixels wide
+// return status (0 for success)
+
+int extractor_run(struct extractor* ex, void* user_struct);
+// same loop as extract_image() but through ex->hooks
+// only allocates if a frame is wider than max_w
+// return status (0 for success, 1 if the stream could not be opened or a
+// buffer could not be allocated; a frame hit by the latter logs no blobs
+// and ends the run)
+
+int extractor_set_threads(struct extractor* ex, int threads);
+// scan frames with this many threads (1 = serial, the default)
+// return status (0 for success)
+
+int extractor_set_rois(struct extractor* ex, const struct roi* rois, int n, int fallback);
+// scan only these n windows of every frame (n = 0 for whole frames)
+// windows are clipped to the frame, overlapping ones are merged
+// with fallback set a frame whose windows log no blob is scanned whole
+// without a prune_blob hook every blob counts, background included
+// return status (0 for success, 1 if n > QUICKBLOB_MAX_ROI)
+
+int extractor_set_engine(struct extractor* ex, int engine, int connectivity);
+// pick the engine of serial scans and which neighbours join a blob
+// connectivity 4 joins runs that share an edge, 8 also diagonal ones
+// return status (0 for success, 1 for an unknown engine or connectivity)
+
+int extractor_set_input(struct extractor* ex, int input);
+// pick how next_row hands over rows, QUICKBLOB_BYTES or QUICKBLOB_BITS
+// return status (0 for success, 1 for an unknown input)
+
+int quickblob_scanner(void);
+// the run scanner the labelling loop was built with (QUICKBLOB_SCAN_*)
+
+int quickblob_run_end(int scanner, const unsigned char* row, int x, int w, unsigned char color);
+// first position >= x in row[0..w) that is not color (w if none), found
+// with the given run scanner, for tests and benchmarks
+// return -1 if this build or CPU does not have the scanner
+
+long extractor_bytes(const struct extractor* ex);
+// bytes held by the row buffers, the blob pool and the engine buffers
+
+void extractor_free(struct extractor* ex);
 
 #endif /* _QUICK_BLOB_H_ */
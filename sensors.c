@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <initio.h>
+#include "periodic.h"
+#include "sensors.h"
+
+
+// Sampling threads: one for the ultrasonic sensor, one for everything else
+#define SENSOR_GROUP_FAST 0
+#define SENSOR_GROUP_US   1
+#define SENSOR_GROUPS     2
+
+// Ring of one channel.  head counts the samples written; the sampling
+// thread is the only writer.
+typedef struct SensorRing {
+    TSensorSample sample[SENSOR_RING_LEN];
+    unsigned long head;
+    long long period;         // sampling period (ns), 0 if not sampled
+    long long next;           // time of the next sample (sampling thread only)
+} TSensorRing;
+
+// Arguments of a sampling thread
+typedef struct SensorGroup {
+    TSensors *s;
+    int group;
+    pthread_t thread;
+    int running;
+} TSensorGroup;
+
+struct Sensors {
+    TSensorRing ring[SENSOR_CHANNELS];
+    TSensorGroup group[SENSOR_GROUPS];
+    int quit;
+};
+
+// Helper functions reading one sensor (the initio functions return BOOL / unsigned).
+static int readIrLeft(void)     { return initio_IrLeft() != 0; }
+static int readIrRight(void)    { return initio_IrRight() != 0; }
+static int readLineLeft(void)   { return initio_IrLineLeft() != 0; }
+static int readLineRight(void)  { return initio_IrLineRight() != 0; }
+static int readUltrasonic(void) { return (int)initio_UsGetDistance(); }
+static int readWheelLeft(void)  { return initio_wheelSensorLeft() != 0; }
+static int readWheelRight(void) { return initio_wheelSensorRight() != 0; }
+
+static int (*const sensor_read[SENSOR_CHANNELS])(void) = {
+    readIrLeft, readIrRight, readLineLeft, readLineRight, readUltrasonic, readWheelLeft, readWheelRight
+};
+
+// Helper function returning the sampling thread of a channel.
+static int channelGroup(int channel) {
+    return channel == SENSOR_ULTRASONIC ? SENSOR_GROUP_US : SENSOR_GROUP_FAST;
+}
+
+// Sampling thread: reads every channel of its group when it is due.
+static void *samplerThread(void *arg) {
+    TSensorGroup *g = (TSensorGroup *)arg;
+    TSensors *s = g->s;
+    TSensorRing *r;
+    TSensorSample *e;
+    struct timespec ts;
+    long long t, wake;
+    int c, value;
+
+    t = monoTimeNs();
+    for (c = 0; c < SENSOR_CHANNELS; c++) {
+        if (channelGroup(c) == g->group) s->ring[c].next = t;
+    }
+
+    while (!__atomic_load_n(&s->quit, __ATOMIC_ACQUIRE)) {
+        // sleep until the earliest channel is due
+        wake = -1;
+        for (c = 0; c < SENSOR_CHANNELS; c++) {
+            r = &s->ring[c];
+            if (r->period == 0 || channelGroup(c) != g->group) continue;
+            if (wake < 0 || r->next < wake) wake = r->next;
+        }
+        if (wake < 0) break;
+        ts.tv_sec = wake / NSEC_PER_SEC;
+        ts.tv_nsec = wake % NSEC_PER_SEC;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+
+        for (c = 0; c < SENSOR_CHANNELS; c++) {
+            r = &s->ring[c];
+            if (r->period == 0 || channelGroup(c) != g->group || r->next > monoTimeNs()) continue;
+            value = sensor_read[c]();
+            t = monoTimeNs();
+            e = &r->sample[r->head % SENSOR_RING_LEN];
+            __atomic_store_n(&e->t, t, __ATOMIC_RELAXED);
+            __atomic_store_n(&e->value, value, __ATOMIC_RELAXED);
+            __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+            // keep the rate; after an overrun continue from now instead of catching up
+            r->next += r->period;
+            if (r->next < t) r->next = t + r->period;
+        }
+    }
+    return NULL;
+}
+
+// Helper function to copy the newest n samples of a ring, newest first.
+// Returns the number copied.
+static int readRing(TSensorRing *r, int n, TSensorSample *out) {
+    unsigned long h, k;
+    int i, m;
+
+    while (1) {
+        h = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        m = h < (unsigned long)n ? (int)h : n;
+        for (i = 0; i < m; i++) {
+            k = (h - 1 - i) % SENSOR_RING_LEN;
+            out[i].t = __atomic_load_n(&r->sample[k].t, __ATOMIC_RELAXED);
+            out[i].value = __atomic_load_n(&r->sample[k].value, __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        // the oldest sample copied is intact unless the writer came round to its slot
+        if (__atomic_load_n(&r->head, __ATOMIC_RELAXED) - (h - m) < SENSOR_RING_LEN) return m;
+    }
+}
+
+// Function to start the sampling threads.
+TSensors *startSensors(const int rates[SENSOR_CHANNELS]) {
+    TSensors *s = (TSensors *)calloc(1, sizeof(TSensors));
+    int c, i;
+
+    if (s == NULL) return NULL;
+    for (c = 0; c < SENSOR_CHANNELS; c++) {
+        s->ring[c].period = rates[c] > 0 ? NSEC_PER_SEC / rates[c] : 0;
+    }
+    for (i = 0; i < SENSOR_GROUPS; i++) {
+        s->group[i].s = s;
+        s->group[i].group = i;
+        for (c = 0; c < SENSOR_CHANNELS; c++) {
+            if (s->ring[c].period && channelGroup(c) == i) break;
+        }
+        if (c == SENSOR_CHANNELS) continue;  // nothing to sample in this group
+        if (pthread_create(&s->group[i].thread, NULL, samplerThread, &s->group[i])) {
+            stopSensors(s);
+            return NULL;
+        }
+        s->group[i].running = 1;
+    }
+    return s;
+}
+
+// Function to read the newest sample.
+int sensorLatest(TSensors *s, int channel, TSensorSample *out) {
+    return readRing(&s->ring[channel], 1, out);
+}
+
+static int cmpValue(const void *a, const void *b) {
+    return ((const TSensorSample *)a)->value - ((const TSensorSample *)b)->value;
+}
+
+// Function to return the median of the newest samples.
+int sensorMedian(TSensors *s, int channel, int n, TSensorSample *out) {
+    TSensorSample win[SENSOR_MEDIAN_MAX];
+    long long t;
+    int m;
+
+    if (n < 1) n = 1;
+    if (n > SENSOR_MEDIAN_MAX) n = SENSOR_MEDIAN_MAX;
+    m = readRing(&s->ring[channel], n, win);
+    if (m == 0) return 0;
+    t = win[0].t;
+    qsort(win, m, sizeof(TSensorSample), cmpValue);
+    out->t = t;
+    out->value = win[m / 2].value;
+    return m;
+}
+
+// Function returning the age of a sample.
+double sensorAge(const TSensorSample *sample) {
+    return (monoTimeNs() - sample->t) / 1e6;
+}
+
+// Function returning the number of samples of a channel.
+unsigned long sensorCount(TSensors *s, int channel) {
+    return __atomic_load_n(&s->ring[channel].head, __ATOMIC_ACQUIRE);
+}
+
+// Function to raise the priority of the fast sampling thread.
+int setSensorsRealtime(TSensors *s, int prio, unsigned long cpus) {
+    if (!s->group[SENSOR_GROUP_FAST].running) return 0;
+    return setThreadRealtime(s->group[SENSOR_GROUP_FAST].thread, prio, cpus);
+}
+
+// Function to stop sampling.
+void stopSensors(TSensors *s) {
+    int i;
+
+    __atomic_store_n(&s->quit, 1, __ATOMIC_RELEASE);
+    for (i = 0; i < SENSOR_GROUPS; i++) {
+        if (s->group[i].running) pthread_join(s->group[i].thread, NULL);
+    }
+    free(s);
+}
@@ -0,0 +1,79 @@
+#ifndef _SENSORS_H_
+#define _SENSORS_H_
+//======================================================================
+//
+// Module that samples the initio sensors in the background, each at its
+// own rate, so the control loop never waits for a sensor.  Every reading
+// is stored with its CLOCK_MONOTONIC time in a per-sensor lock-free ring;
+// readers take the latest sample or the median of the last few.
+//
+// The ultrasonic sensor blocks for the echo round trip, so it is sampled
+// by a thread of its own; all other sensors share one sampling thread.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+// Sensor channels
+#define SENSOR_IR_LEFT     0
+#define SENSOR_IR_RIGHT    1
+#define SENSOR_LINE_LEFT   2
+#define SENSOR_LINE_RIGHT  3
+#define SENSOR_ULTRASONIC  4   // value in cm, 0 == no object
+#define SENSOR_WHEEL_LEFT  5
+#define SENSOR_WHEEL_RIGHT 6
+#define SENSOR_CHANNELS    7
+
+// Samples kept per channel (power of two), and the longest median window
+#define SENSOR_RING_LEN 64
+#define SENSOR_MEDIAN_MAX 15
+
+// One reading
+typedef struct SensorSample {
+  long long t;              // CLOCK_MONOTONIC time in nanoseconds
+  int value;
+} TSensorSample;
+
+// Handle of the running sampler
+typedef struct Sensors TSensors;
+
+
+//======================================================================
+// startSensors():
+// Start sampling; rates[c] is the rate of channel c in Hz (0: not sampled).
+// The threads inherit scheduling policy and CPU affinity of the caller.
+// Returns NULL on failure.
+TSensors *startSensors(const int rates[SENSOR_CHANNELS]);
+
+// sensorLatest():
+// Copy the newest sample of a channel.  Returns 0 if there is none yet.
+int sensorLatest(TSensors *s, int channel, TSensorSample *out);
+
+// sensorMedian():
+// Median value of the newest n (1..SENSOR_MEDIAN_MAX) samples of a channel,
+// with the time of the newest one.  Returns the number of samples used
+// (fewer than n early on), 0 if there is none yet.
+int sensorMedian(TSensors *s, int channel, int n, TSensorSample *out);
+
+// sensorAge():
+// Age in milliseconds of a sample taken from this module.
+double sensorAge(const TSensorSample *sample);
+
+// sensorCount():
+// Number of samples taken on a channel so far.
+unsigned long sensorCount(TSensors *s, int channel);
+
+// setSensorsRealtime():
+// Apply setThreadRealtime() (see periodic.h) to the thread sampling the fast
+// sensors.  The ultrasonic thread keeps the normal policy, as the echo wait
+// of the sensor may spin.  Returns the RT_* flags that succeeded.
+int setSensorsRealtime(TSensors *s, int prio, unsigned long cpus);
+
+// stopSensors():
+// Stop the sampling threads and free the sampler.
+void stopSensors(TSensors *s);
+
+
+#endif /* _SENSORS_H_ */
@@ -0,0 +1,385 @@
+//======================================================================
+//
+// Simulated drop-in replacement for the initio library (and the timing
+// and interrupt functions of wiringPi it pulls in).  All sensors and motors
+// act on a TSimWorld that advances in real time, and a camera thread renders
+// the car's view at SIM_CAMERA_FPS and writes it as MJPEG into the FIFO
+// SIM_CAMERA_FIFO, from where CAMERA_STREAM_CMD of the sim build reads it.
+// Edges of the wheel sensors raise the handlers set with wiringPiISR().
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <initio.h>
+#include "sim_world.h"
+
+// Camera settings (same as CAMERA_STREAM_CMD on the car)
+#define SIM_CAMERA_W 200
+#define SIM_CAMERA_H 200
+#define SIM_CAMERA_FPS 30
+#define SIM_CAMERA_QUALITY 85
+
+// Ultrasonic echo time per cm of distance, and the time-out without an echo (us)
+#define SIM_US_ECHO_US 58
+#define SIM_US_TIMEOUT_US 30000
+
+// Rate at which the simulated GPIO interrupt thread looks for wheel sensor edges
+#define SIM_ISR_HZ 5000
+
+// Speed of the lead vehicle (m/s)
+#define SIM_LEAD_SPEED 0.15
+
+static TSimWorld world;
+static pthread_mutex_t world_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec world_clock;     // wall clock time of world.t
+static pthread_t camera_thread;
+static int camera_running = 0;
+static int camera_quit = 0;
+static struct timespec start_clock;     // for millis() / micros()
+
+// GPIO interrupt handlers of the wheel sensors (wiringPiISR())
+typedef struct SimIsr {
+    int pin;
+    int (*sensor)(TSimWorld *);
+    int mode;                   // INT_EDGE_*, 0: no handler
+    void (*function)(void);
+    int level;
+} TSimIsr;
+
+static TSimIsr isr[2] = {{wheelLeft, simWheelLeft}, {wheelRight, simWheelRight}};
+static pthread_mutex_t isr_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t isr_thread;
+static int isr_running = 0;
+static int isr_quit = 0;
+
+// Helper function returning the seconds from a to b.
+static double elapsed(const struct timespec *a, const struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) * 1e-9;
+}
+
+// Helper function to lock the world and bring it up to the current time.
+static TSimWorld *lockWorld(void) {
+    struct timespec now;
+
+    pthread_mutex_lock(&world_lock);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    simWorldStep(&world, elapsed(&world_clock, &now));
+    world_clock = now;
+    return &world;
+}
+
+static void unlockWorld(void) {
+    pthread_mutex_unlock(&world_lock);
+}
+
+// Helper function to write all of buf, returns -1 if the reader went away.
+static int writeAll(int fd, const unsigned char *buf, unsigned long len) {
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Camera thread: renders frames into the FIFO while a reader is connected.
+static void *cameraThread(void *arg) {
+    TJImage img;
+    unsigned char *jpeg;
+    unsigned long len;
+    struct timespec next;
+    int fd = -1;
+
+    memset(&img, 0, sizeof(img));
+    img.w = SIM_CAMERA_W;
+    img.h = SIM_CAMERA_H;
+    img.numChannels = 3;
+    img.data = (unsigned char *)malloc(SIM_CAMERA_W * SIM_CAMERA_H * 3);
+    if (img.data == NULL) return NULL;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!__atomic_load_n(&camera_quit, __ATOMIC_ACQUIRE)) {
+        if (fd < 0) {
+            fd = open(SIM_CAMERA_FIFO, O_WRONLY);  // blocks until a reader opens the FIFO
+            if (fd < 0) break;
+            clock_gettime(CLOCK_MONOTONIC, &next);
+            continue;
+        }
+        simRender(lockWorld(), &img);
+        unlockWorld();
+        len = simEncodeJpeg(&img, SIM_CAMERA_QUALITY, &jpeg);
+        if (writeAll(fd, jpeg, len)) {
+            close(fd);  // reader closed, wait for the next one
+            fd = -1;
+        }
+        free(jpeg);
+
+        next.tv_nsec += 1000000000L / SIM_CAMERA_FPS;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
+    }
+    if (fd >= 0) close(fd);
+    free(img.data);
+    return NULL;
+}
+
+
+// Interrupt thread: calls the handlers on the edges of the wheel sensors,
+// like the interrupt threads of wiringPi.
+static void *isrThread(void *arg) {
+    struct timespec next;
+    int i, level, fire[2];
+    TSimWorld *w;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!__atomic_load_n(&isr_quit, __ATOMIC_ACQUIRE)) {
+        next.tv_nsec += 1000000000L / SIM_ISR_HZ;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
+
+        pthread_mutex_lock(&isr_lock);
+        w = lockWorld();
+        for (i = 0; i < 2; i++) {
+            level = isr[i].sensor(w);
+            fire[i] = isr[i].mode && level != isr[i].level &&
+                      (isr[i].mode == INT_EDGE_BOTH || (isr[i].mode == INT_EDGE_RISING) == level);
+            isr[i].level = level;
+        }
+        unlockWorld();
+        pthread_mutex_unlock(&isr_lock);
+        // handlers run without any sim lock held
+        for (i = 0; i < 2; i++) {
+            if (fire[i]) isr[i].function();
+        }
+    }
+    return NULL;
+}
+
+
+//======================================================================
+// General Functions
+
+int initio_identifyControlBoard() {
+    return PIROCON2;
+}
+
+void initio_Init() {
+    const char *noise = getenv("SIM_NOISE");
+
+    clock_gettime(CLOCK_MONOTONIC, &start_clock);
+    pthread_mutex_lock(&world_lock);
+    simWorldInit(&world, SIM_LEAD_SPEED, noise ? atof(noise) : 0.0, 1);
+    world_clock = start_clock;
+    pthread_mutex_unlock(&world_lock);
+
+    // a reader that disappears must not kill the program
+    signal(SIGPIPE, SIG_IGN);
+    if (mkfifo(SIM_CAMERA_FIFO, 0600) && errno != EEXIST) {
+        fprintf(stderr, "initio_Init: cannot create %s\n", SIM_CAMERA_FIFO);
+        return;
+    }
+    camera_quit = 0;
+    camera_running = (pthread_create(&camera_thread, NULL, cameraThread, NULL) == 0);
+}
+
+void initio_Cleanup() {
+    int fd;
+
+    initio_Stop();
+    if (camera_running) {
+        __atomic_store_n(&camera_quit, 1, __ATOMIC_RELEASE);
+        // let a camera thread blocked in open() through
+        fd = open(SIM_CAMERA_FIFO, O_RDONLY | O_NONBLOCK);
+        pthread_join(camera_thread, NULL);
+        if (fd >= 0) close(fd);
+        camera_running = 0;
+    }
+    unlink(SIM_CAMERA_FIFO);
+    if (isr_running) {
+        __atomic_store_n(&isr_quit, 1, __ATOMIC_RELEASE);
+        pthread_join(isr_thread, NULL);
+        isr_running = 0;
+    }
+}
+
+float initio_Version() {
+    return 0.0f;  // simulation
+}
+
+
+//======================================================================
+// Motor Functions
+
+// Helper function to set both motor commands.
+static void setMotors(double left, double right) {
+    simSetMotors(lockWorld(), left, right);
+    unlockWorld();
+}
+
+void initio_Stop() {
+    setMotors(0, 0);
+}
+
+void initio_DriveForward(int8_t speed) {
+    setMotors(speed, speed);
+}
+
+void initio_DriveReverse(int8_t speed) {
+    setMotors(-speed, -speed);
+}
+
+void initio_SpinLeft(int8_t speed) {
+    setMotors(-speed, speed);
+}
+
+void initio_SpinRight(int8_t speed) {
+    setMotors(speed, -speed);
+}
+
+void initio_TurnForward(int8_t leftSpeed, int8_t rightSpeed) {
+    setMotors(leftSpeed, rightSpeed);
+}
+
+void initio_TurnReverse(int8_t leftSpeed, int8_t rightSpeed) {
+    setMotors(-leftSpeed, -rightSpeed);
+}
+
+
+//======================================================================
+// Sensor Functions
+
+// Helper function to read one sensor of the up-to-date world.
+static int readSensor(int (*sensor)(TSimWorld *)) {
+    int res = sensor(lockWorld());
+
+    unlockWorld();
+    return res;
+}
+
+BOOL initio_wheelSensorLeft(void) {
+    return readSensor(simWheelLeft);
+}
+
+BOOL initio_wheelSensorRight(void) {
+    return readSensor(simWheelRight);
+}
+
+BOOL initio_IrLeft(void) {
+    return readSensor(simIrLeft);
+}
+
+BOOL initio_IrRight(void) {
+    return readSensor(simIrRight);
+}
+
+BOOL initio_IrAll(void) {
+    return initio_IrLeft() || initio_IrRight();
+}
+
+BOOL initio_IrLineLeft(void) {
+    return readSensor(simLineLeft);
+}
+
+BOOL initio_IrLineRight(void) {
+    return readSensor(simLineRight);
+}
+
+unsigned int initio_UsGetDistance(void) {
+    unsigned int d = simUsDistance(lockWorld());
+
+    unlockWorld();
+    // the real sensor blocks for the echo round trip (58 us per cm),
+    // or until its timeout when nothing is in range
+    usleep(d ? d * SIM_US_ECHO_US : SIM_US_TIMEOUT_US);
+    return d;
+}
+
+
+//======================================================================
+// Servo Functions
+
+void initio_StartServos(void) {
+}
+
+void initio_StopServos(void) {
+}
+
+void initio_SetServo(int8_t servo, int8_t degrees) {
+    TSimWorld *w = lockWorld();
+
+    if (degrees < -90) degrees = -90;
+    if (degrees > 90) degrees = 90;
+    if (servo == servoPan) w->pan = degrees * M_PI / 180;
+    if (servo == servoTilt) w->tilt = degrees * M_PI / 180;
+    unlockWorld();
+}
+
+
+//======================================================================
+// Timing and interrupt functions of wiringPi
+
+void delay(unsigned int howLong) {
+    usleep(howLong * 1000);
+}
+
+void delayMicroseconds(unsigned int howLong) {
+    usleep(howLong);
+}
+
+int wiringPiISR(int pin, int mode, void (*function)(void)) {
+    int i, res = -1;
+
+    pthread_mutex_lock(&isr_lock);
+    for (i = 0; i < 2; i++) {
+        if (isr[i].pin != pin || mode < INT_EDGE_FALLING || mode > INT_EDGE_BOTH) continue;
+        isr[i].level = readSensor(isr[i].sensor);
+        isr[i].function = function;
+        isr[i].mode = mode;
+        res = 0;
+    }
+    if (res == 0 && !isr_running) {
+        isr_quit = 0;
+        isr_running = (pthread_create(&isr_thread, NULL, isrThread, NULL) == 0);
+        if (!isr_running) res = -1;
+    }
+    pthread_mutex_unlock(&isr_lock);
+    return res;
+}
+
+unsigned int millis(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned int)(elapsed(&start_clock, &now) * 1000);
+}
+
+unsigned int micros(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned int)(elapsed(&start_clock, &now) * 1000000);
+}
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <jpeglib.h>
+#include "sim_world.h"
+
+// Semi-axes of the lead vehicle's ellipse (m)
+#define LEAD_AX 1.0
+#define LEAD_AY 0.8
+
+// Longest integration step (s)
+#define MAX_STEP 0.005
+
+// Angle of the IR obstacle sensors to the heading (rad)
+#define IR_ANGLE 0.52
+
+// Position of the line sensors relative to the car centre (m)
+#define LINE_FWD  0.08
+#define LINE_SIDE 0.04
+
+// Rendered colors
+static const unsigned char wall_rgb[3]  = {150, 150, 160};
+static const unsigned char floor_rgb[3] = {90, 80, 70};
+static const unsigned char lead_rgb[3]  = {255, 0, 0};
+
+// Helper function to set the lead vehicle's pose from its phase.
+static void leadPose(TSimWorld *w) {
+    w->lead.x = LEAD_AX * cos(w->leadPhase);
+    w->lead.y = LEAD_AY * sin(w->leadPhase);
+    w->lead.th = atan2(LEAD_AY * cos(w->leadPhase), -LEAD_AX * sin(w->leadPhase));
+}
+
+// Function to set up the world.
+void simWorldInit(TSimWorld *w, double lead_speed, double noise, unsigned int seed) {
+    w->t = 0.0;
+    w->car.x = w->car.y = w->car.th = 0.0;
+    w->leadPhase = 0.0;
+    w->leadSpeed = lead_speed;
+    leadPose(w);
+    w->left = w->right = 0.0;
+    w->travelL = w->travelR = 0.0;
+    w->pan = w->tilt = 0.0;
+    w->collisions = 0;
+    w->seed = seed;
+    w->noise = noise;
+}
+
+// Helper function to check whether a car at (x,y) touches a wall or the lead vehicle.
+static int blocked(TSimWorld *w, double x, double y) {
+    double lim = SIM_ARENA / 2 - SIM_CAR_RADIUS;
+
+    if (fabs(x) > lim || fabs(y) > lim) return 1;
+    return hypot(x - w->lead.x, y - w->lead.y) < 2 * SIM_CAR_RADIUS;
+}
+
+// Helper function to advance the world by one short step.
+static void step(TSimWorld *w, double dt) {
+    double vl = w->left / 100.0 * SIM_MAX_SPEED;
+    double vr = w->right / 100.0 * SIM_MAX_SPEED;
+    double v = (vl + vr) / 2, om = (vr - vl) / SIM_WHEEL_BASE;
+    double th = w->car.th + om * dt / 2;
+    double x = w->car.x + v * dt * cos(th);
+    double y = w->car.y + v * dt * sin(th);
+    double speed;
+
+    // lead vehicle: advance along the ellipse at constant path speed
+    if (w->leadSpeed > 0) {
+        speed = hypot(LEAD_AX * sin(w->leadPhase), LEAD_AY * cos(w->leadPhase));
+        w->leadPhase += w->leadSpeed * dt / speed;
+        leadPose(w);
+    }
+
+    w->car.th = remainder(w->car.th + om * dt, 2 * M_PI);
+    if (blocked(w, x, y)) {
+        if (v != 0) w->collisions++;
+    } else {
+        w->car.x = x;
+        w->car.y = y;
+    }
+    w->travelL += fabs(vl) * dt;
+    w->travelR += fabs(vr) * dt;
+    w->t += dt;
+}
+
+// Function to advance the world.
+void simWorldStep(TSimWorld *w, double dt) {
+    while (dt > MAX_STEP) {
+        step(w, MAX_STEP);
+        dt -= MAX_STEP;
+    }
+    if (dt > 0) step(w, dt);
+}
+
+// Function to set the motor commands.
+void simSetMotors(TSimWorld *w, double left, double right) {
+    w->left = left;
+    w->right = right;
+}
+
+// Helper function to return the distance from (x,y) along angle a to the nearest
+// wall or the lead vehicle.
+static double rayDist(TSimWorld *w, double x, double y, double a) {
+    double dx = cos(a), dy = sin(a), half = SIM_ARENA / 2;
+    double d = 1e9, t, ox, oy, b, c, disc;
+
+    // walls
+    if (dx > 1e-9) d = fmin(d, (half - x) / dx);
+    if (dx < -1e-9) d = fmin(d, (-half - x) / dx);
+    if (dy > 1e-9) d = fmin(d, (half - y) / dy);
+    if (dy < -1e-9) d = fmin(d, (-half - y) / dy);
+
+    // lead vehicle (circle)
+    ox = x - w->lead.x;
+    oy = y - w->lead.y;
+    b = ox * dx + oy * dy;
+    c = ox * ox + oy * oy - SIM_CAR_RADIUS * SIM_CAR_RADIUS;
+    disc = b * b - c;
+    if (disc >= 0) {
+        t = -b - sqrt(disc);
+        if (t >= 0) d = fmin(d, t);
+    }
+    return d;
+}
+
+// Helper function for the IR obstacle sensors (side: +1 left, -1 right).
+static int irSensor(TSimWorld *w, int side) {
+    double x = w->car.x + SIM_CAR_RADIUS * cos(w->car.th);
+    double y = w->car.y + SIM_CAR_RADIUS * sin(w->car.th);
+
+    return rayDist(w, x, y, w->car.th + side * IR_ANGLE) < SIM_IR_RANGE;
+}
+
+int simIrLeft(TSimWorld *w) {
+    return irSensor(w, 1);
+}
+
+int simIrRight(TSimWorld *w) {
+    return irSensor(w, -1);
+}
+
+// Helper function for the line sensors: the floor is marked along the walls.
+static int lineSensor(TSimWorld *w, int side) {
+    double c = cos(w->car.th), s = sin(w->car.th);
+    double x = w->car.x + LINE_FWD * c - side * LINE_SIDE * s;
+    double y = w->car.y + LINE_FWD * s + side * LINE_SIDE * c;
+    double lim = SIM_ARENA / 2 - SIM_BORDER;
+
+    return fabs(x) > lim || fabs(y) > lim;
+}
+
+int simLineLeft(TSimWorld *w) {
+    return lineSensor(w, 1);
+}
+
+int simLineRight(TSimWorld *w) {
+    return lineSensor(w, -1);
+}
+
+// Wheel sensors toggle every SIM_WHEEL_SLOT of travel.
+int simWheelLeft(TSimWorld *w) {
+    return (long)(w->travelL / SIM_WHEEL_SLOT) & 1;
+}
+
+int simWheelRight(TSimWorld *w) {
+    return (long)(w->travelR / SIM_WHEEL_SLOT) & 1;
+}
+
+// Function for the ultrasonic sensor: nearest echo within the beam.
+unsigned int simUsDistance(TSimWorld *w) {
+    double x = w->car.x + SIM_CAR_RADIUS * cos(w->car.th);
+    double y = w->car.y + SIM_CAR_RADIUS * sin(w->car.th);
+    double d = 1e9;
+    int i;
+
+    for (i = -3; i <= 3; i++) {
+        d = fmin(d, rayDist(w, x, y, w->car.th + i * SIM_US_CONE / 3));
+    }
+    if (d > SIM_US_RANGE) return 0;
+    return (unsigned int)(d * 100 + 0.5);
+}
+
+// Helper function to project the lead vehicle into the camera: returns the
+// distance along the optical axis and sets its column offset from the centre
+// for a focal length of f pixels.
+static double leadProject(TSimWorld *w, double f, double *du) {
+    double yaw = w->car.th + w->pan;
+    double dx = w->lead.x - w->car.x, dy = w->lead.y - w->car.y;
+    double fx = dx * cos(yaw) + dy * sin(yaw);
+    double fy = -dx * sin(yaw) + dy * cos(yaw);
+
+    *du = fx > 0 ? -f * fy / fx : 0;
+    return fx;
+}
+
+// Function returning the ground truth image position of the lead vehicle.
+int simLeadInView(TSimWorld *w, int w_px, double *u, double *width) {
+    double f = (w_px / 2.0) / tan(SIM_CAM_FOV / 2);
+    double du, fx = leadProject(w, f, &du);
+
+    if (fx < 0.05) return 0;
+    *width = f * SIM_LEAD_WIDTH / fx;
+    *u = w_px / 2.0 - 0.5 + du;
+    return *u + *width / 2 >= 0 && *u - *width / 2 <= w_px - 1;
+}
+
+// Function to render the camera view.
+void simRender(TSimWorld *w, TJImage *pimg) {
+    int W = pimg->w, H = pimg->h, x, y, c, v;
+    double f = (W / 2.0) / tan(SIM_CAM_FOV / 2);
+    double horizon = H / 2.0 - f * tan(w->tilt);
+    double u, width, du, fx, top = -1, bot = -1, left = -1, right = -1;
+    const unsigned char *rgb;
+    unsigned char *p = pimg->data;
+
+    if (simLeadInView(w, W, &u, &width)) {
+        fx = leadProject(w, f, &du);
+        left = u - width / 2;
+        right = u + width / 2;
+        top = horizon - f * (SIM_LEAD_TOP - SIM_CAM_HEIGHT) / fx;
+        bot = horizon - f * (SIM_LEAD_BOTTOM - SIM_CAM_HEIGHT) / fx;
+    }
+    for (y = 0; y < H; y++) {
+        for (x = 0; x < W; x++) {
+            if (x >= left && x <= right && y >= top && y <= bot) {
+                rgb = lead_rgb;
+            } else {
+                rgb = y < horizon ? wall_rgb : floor_rgb;
+            }
+            for (c = 0; c < 3; c++) {
+                v = rgb[c];
+                if (w->noise > 0) v += (int)((rand_r(&w->seed) / (double)RAND_MAX - 0.5) * 2 * w->noise);
+                *p++ = v < 0 ? 0 : (v > 255 ? 255 : v);
+            }
+        }
+    }
+}
+
+// Function to compress a rendered image into memory.
+unsigned long simEncodeJpeg(TJImage *pimg, int quality, unsigned char **buf) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    JSAMPROW row_pointer;
+    unsigned long size = 0;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    *buf = NULL;
+    jpeg_mem_dest(&cinfo, buf, &size);
+    cinfo.image_width = pimg->w;
+    cinfo.image_height = pimg->h;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        row_pointer = &pimg->data[cinfo.next_scanline * pimg->w * 3];
+        jpeg_write_scanlines(&cinfo, &row_pointer, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return size;
+}
@@ -0,0 +1,109 @@
+#ifndef _SIM_WORLD_H_
+#define _SIM_WORLD_H_
+//======================================================================
+//
+// Module with a 2-D kinematic model of the robot car, a red lead
+// vehicle and the walls of a square arena, used to simulate the initio
+// sensors and the camera off the Raspberry PI.
+//
+// Coordinates are in metres, angles in radians (counter-clockwise).
+// The car is a differential drive: motor commands -100..100 percent map
+// linearly to wheel speeds.  The lead vehicle drives a fixed ellipse
+// around the car's start position.  The camera sits on the pan servo and looks along the car's
+// heading.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include "detect_blob.h"
+
+// FIFO into which the simulated camera of initio_sim.c writes MJPEG
+#define SIM_CAMERA_FIFO "/tmp/camcar_sim.mjpeg"
+
+// Car and arena geometry
+#define SIM_ARENA        4.0    // side length of the arena (walls at +-SIM_ARENA/2)
+#define SIM_WHEEL_BASE   0.14   // distance between the wheels
+#define SIM_MAX_SPEED    0.50   // wheel speed at 100 percent (m/s)
+#define SIM_CAR_RADIUS   0.10   // footprint of both vehicles (m)
+#define SIM_WHEEL_SLOT   0.01   // wheel travel between two wheel sensor edges (m)
+#define SIM_BORDER       0.25   // width of the line marking along the walls (m)
+
+// Sensor ranges
+#define SIM_IR_RANGE     0.15   // obstacle sensors (m), 30 degrees left/right of the heading
+#define SIM_US_RANGE     4.00   // ultrasonic sensor (m), returns 0 beyond
+#define SIM_US_CONE      0.26   // half opening angle of the ultrasonic beam (rad)
+
+// Camera (Raspberry PI camera v1: 53.5 degrees horizontal field of view)
+#define SIM_CAM_FOV      0.934  // horizontal field of view (rad)
+#define SIM_CAM_HEIGHT   0.10   // height of the lens above the floor (m)
+
+// Red rear face of the lead vehicle
+#define SIM_LEAD_WIDTH   0.16
+#define SIM_LEAD_BOTTOM  0.04
+#define SIM_LEAD_TOP     0.18
+
+// Pose of a vehicle
+typedef struct SimPose {
+  double x, y, th;
+} TSimPose;
+
+// State of the simulated world
+typedef struct SimWorld {
+  double t;                 // simulated time (s)
+  TSimPose car;
+  TSimPose lead;
+  double leadPhase;         // position of the lead vehicle on its ellipse (rad)
+  double leadSpeed;         // speed of the lead vehicle along its path (m/s)
+  double left, right;       // motor commands (-100..100 percent)
+  double travelL, travelR;  // distance rolled by each wheel (m, always positive)
+  double pan, tilt;         // servo angles (rad)
+  int collisions;           // number of steps in which the car touched something
+  unsigned int seed;        // state of the pixel noise generator
+  double noise;             // amplitude of the pixel noise (0..255)
+} TSimWorld;
+
+
+//======================================================================
+// simWorldInit():
+// Car at the origin facing +x, lead vehicle 1 m ahead, driving its ellipse
+// counter-clockwise at lead_speed (0: standing).
+// Pixel noise of the given amplitude uses the given seed, so runs repeat exactly.
+void simWorldInit(TSimWorld *w, double lead_speed, double noise, unsigned int seed);
+
+// simWorldStep():
+// Advance the world by dt seconds.
+void simWorldStep(TSimWorld *w, double dt);
+
+// simSetMotors():
+// Set both motor commands in percent (negative: backwards).
+void simSetMotors(TSimWorld *w, double left, double right);
+
+// Sensor models (same meaning as the initio functions)
+int simIrLeft(TSimWorld *w);
+int simIrRight(TSimWorld *w);
+int simLineLeft(TSimWorld *w);
+int simLineRight(TSimWorld *w);
+int simWheelLeft(TSimWorld *w);
+int simWheelRight(TSimWorld *w);
+unsigned int simUsDistance(TSimWorld *w);   // cm, 0 == no object
+
+// simLeadInView():
+// Ground truth for the camera: returns 1 if the lead vehicle is in front of
+// the camera and sets *u to the image column of its centre and *width to
+// its width in pixels for an image of w_px columns.
+int simLeadInView(TSimWorld *w, int w_px, double *u, double *width);
+
+// simRender():
+// Render the camera view into pimg (3 channels, pimg->w x pimg->h).
+void simRender(TSimWorld *w, TJImage *pimg);
+
+// simEncodeJpeg():
+// Compress pimg (3 channels) into a new JPEG buffer returned in *buf, which
+// the caller releases with free().  Returns the length of the JPEG data.
+unsigned long simEncodeJpeg(TJImage *pimg, int quality, unsigned char **buf);
+
+
+#endif /* _SIM_WORLD_H_ */
@@ -0,0 +1,548 @@
+//======================================================================
+//
+// Closed-loop benchmark of the blob detector and tracker on the simulated
+// world.  The car follows the lead vehicle with a proportional controller
+// running at CTRL_RATE; the camera delivers a picture every 1/fps seconds
+// and its search result arrives RESULT_DELAY later.  The run is repeated
+// with two controllers: one holding the latest search result, as the FSM
+// of camcar did, and one steering by the prediction of blob_track.c (with
+// the car's true heading standing in for odometry).  The world is stepped
+// in simulated time, so the runs are reproducible and as fast as the
+// machine allows.
+//
+// Reported are detector throughput and latency, detection rate and
+// position error against the ground truth, the cost of a whole-frame
+// search against followSearchBlob() (as used by the pipeline) on the same
+// pictures, the frame rate of a serial worker (the pipeline's decode and
+// search, one frame after the other) against the pipeline on a replay of
+// the first run's JPEGs,
+// a sweep of the coarse-to-fine search over frame sizes and
+// distances of the lead vehicle, searches from byte against packed rows,
+// and per controller the error
+// of the blob position it steered by, how smooth its steering was, and
+// how well the car kept up with the lead vehicle.
+//
+// usage: simbench [frames [noise [seed [fps]]]]
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "detect_blob.h"
+#include "blob_track.h"
+#include "pipeline.h"
+#include "periodic.h"
+#include "camera_stream.h"
+#include "sim_world.h"
+
+#define FRAME_W 200
+#define FRAME_H 200
+#define JPEG_QUALITY 85
+#define LEAD_SPEED 0.15
+
+// Control loop rate (Hz) and the latency from capture to search result (s)
+#define CTRL_RATE 100
+#define RESULT_DELAY 0.04
+
+// Follow controller: turn towards the blob, keep its width at TARGET_WIDTH pixels
+#define TARGET_WIDTH 24.0
+#define K_TURN 40.0
+#define K_DRIVE 2.0
+
+// Width of the lead vehicle's face in pixels for a blob of the given size
+#define BLOB_WIDTH(size) sqrt((size) * SIM_LEAD_WIDTH / (SIM_LEAD_TOP - SIM_LEAD_BOTTOM))
+
+// Pyramid sweep: square frame sizes, distances to the standing lead vehicle
+// (m), and repetitions of each search for the timing
+#define PYR_SIZES     { 200, 400, 800, 1600 }
+#define PYR_DISTANCES { 0.3, 0.6, 1.2 }
+#define PYR_REPEAT    20
+
+// Replay of the first run: frames, feed rates of the pipeline as multiples
+// of the serial worker's rate, and the share of drops still counted as sustained
+#define REPLAY_FRAMES   600
+#define REPLAY_RATES    { 0.5, 0.75, 1.0, 1.25, 1.5, 2.0 }
+#define REPLAY_MAX_DROP 0.01
+#define REPLAY_REPEATS  3
+
+// Distance to the lead vehicle (m) for the comparison of byte and packed rows
+#define PACK_DISTANCE 0.6
+
+// Search results on their way to the controller (more than RESULT_DELAY * fps)
+#define PENDING_LEN 16
+
+// Controllers compared
+#define CTRL_HOLD  0
+#define CTRL_TRACK 1
+
+// Results of one run
+typedef struct BenchRun {
+    double *lat;              // detector latency per frame (s)
+    double busy;              // detector time (s)
+    int nVisible, nHit, nFalse;  // frames with the lead in view, detected, false positives
+    double errSum, errMax;    // detector centre error (px)
+    double *estErr;           // error of the blob position steered by, per control step (px)
+    double estSum;
+    int nEst;
+    double steerSum, steerMax;   // change of the turn command per control step
+    int nSteer, reversals;    // steps with a command, sign changes of the turn command
+    double distSum;           // distance to the lead vehicle summed over the steps
+    int steps, inView, collisions;
+} TBenchRun;
+
+// Whole-frame against window searches (first run only)
+typedef struct WindowBench {
+    double *full, *win;       // search time per frame (s)
+    double pixFull, pixWin;   // pixels scanned
+    int same;                 // frames with identical results
+    TBlobFollow follow;
+} TWindowBench;
+
+static int cmpDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Helper function to search picture i of a run whole and with followSearchBlob().
+static void benchWindow(TJImage *img, int i, TWindowBench *wb) {
+    const char red[3] = {255, 0, 0};
+    TBlobSearch full, win;
+    double t0;
+
+    t0 = monoTime();
+    full = imageSearchBlob(red, img);
+    wb->full[i] = monoTime() - t0;
+    wb->pixFull += getBlobSearchPixels();
+
+    t0 = monoTime();
+    win = followSearchBlob(&wb->follow, red, img);
+    wb->win[i] = monoTime() - t0;
+    wb->pixWin += getBlobSearchPixels();
+    if (win.size == full.size && win.blob.center_x == full.blob.center_x &&
+        win.blob.center_y == full.blob.center_y) wb->same++;
+}
+
+// Helper function timing PYR_REPEAT searches of img at the given pyramid
+// factor; returns the time of one search (s) and the result in *blob.
+static double timeSearch(TJImage *img, int factor, TBlobSearch *blob) {
+    const char red[3] = {255, 0, 0};
+    double t0;
+    int k;
+
+    setBlobSearchPyramid(factor);
+    t0 = monoTime();
+    for (k = 0; k < PYR_REPEAT; k++) *blob = imageSearchBlob(red, img);
+    return (monoTime() - t0) / PYR_REPEAT;
+}
+
+// Helper function for the sweep of the coarse-to-fine search: the car looks
+// at the standing lead vehicle from several distances, pictures of several
+// sizes are searched at full resolution and coarse to fine.
+static void benchPyramid(double noise, unsigned int seed) {
+    static const int sizes[] = PYR_SIZES;
+    static const double dist[] = PYR_DISTANCES;
+    static const int factors[2] = { 2, 4 };
+    TSimWorld w;
+    TJImage img = {0};
+    TBlobSearch full, pyr;
+    double tFull, t;
+    int s, d, f;
+
+    printf("coarse-to-fine search (time full resolution -> factor 2 / 4, speedup, "
+           "size and centre difference to full resolution):\n");
+    for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        img.w = img.h = sizes[s];
+        img.numChannels = 3;
+        img.data = (unsigned char *)malloc((size_t)img.w * img.h * 3);
+        if (img.data == NULL) return;
+        for (d = 0; d < (int)(sizeof(dist) / sizeof(dist[0])); d++) {
+            simWorldInit(&w, 0.0, noise, seed);
+            w.car.x = w.lead.x - dist[d];
+            simRender(&w, &img);
+            tFull = timeSearch(&img, 1, &full);
+            printf("  %4dx%-4d %.1f m, blob %6d px (%4.1f%%): %8.1f us", img.w, img.h, dist[d], full.size,
+                   100.0 * full.size / (img.w * img.h), tFull * 1e6);
+            for (f = 0; f < 2; f++) {
+                t = timeSearch(&img, factors[f], &pyr);
+                printf(" | x%d %8.1f us %4.1fx, size %+d, centre %.2f px", factors[f], t * 1e6, tFull / t,
+                       pyr.size - full.size, hypot(pyr.blob.center_x - full.blob.center_x,
+                                                   pyr.blob.center_y - full.blob.center_y));
+            }
+            printf("\n");
+        }
+        free(img.data);
+    }
+    setBlobSearchPyramid(1);
+}
+
+// Helper function comparing whole-picture searches from byte rows and from
+// packed rows (see setBlobSearchPacked()), with both labelling engines, over
+// the frame sizes of the pyramid sweep and the lead vehicle at PACK_DISTANCE.
+static void benchPacked(double noise, unsigned int seed) {
+    static const int sizes[] = PYR_SIZES;
+    static const int engines[2] = { BLOB_ENGINE_LISTS, BLOB_ENGINE_UNION_FIND };
+    static const char *names[2] = { "lists", "union-find" };
+    TSimWorld w;
+    TJImage img = {0};
+    TBlobSearch bytes, packed;
+    double tBytes, tPacked;
+    int s, e;
+
+    printf("packed rows (whole search, time bytes -> packed, speedup, same result):\n");
+    for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        img.w = img.h = sizes[s];
+        img.numChannels = 3;
+        img.data = (unsigned char *)malloc((size_t)img.w * img.h * 3);
+        if (img.data == NULL) return;
+        simWorldInit(&w, 0.0, noise, seed);
+        w.car.x = w.lead.x - PACK_DISTANCE;
+        simRender(&w, &img);
+        printf("  %4dx%-4d", img.w, img.h);
+        for (e = 0; e < 2; e++) {
+            setBlobSearchEngine(engines[e], 4);
+            setBlobSearchPacked(0);
+            tBytes = timeSearch(&img, 1, &bytes);
+            setBlobSearchPacked(1);
+            tPacked = timeSearch(&img, 1, &packed);
+            printf(" | %s %8.1f -> %8.1f us %4.2fx %s", names[e], tBytes * 1e6, tPacked * 1e6, tBytes / tPacked,
+                   bytes.size == packed.size && bytes.blob.center_x == packed.blob.center_x &&
+                   bytes.blob.center_y == packed.blob.center_y ? "yes" : "NO");
+        }
+        printf("\n");
+        free(img.data);
+    }
+    setBlobSearchEngine(BLOB_ENGINE_LISTS, 4);
+}
+
+// Pipeline callback of benchReplay(), counts the frames searched.
+static void countResult(void *ctx, const TBlobSearch *blob, unsigned long seq, double t) {
+    (*(unsigned long *)ctx)++;
+}
+
+// Source of a paced replay: the recorded frames written into a pipe at a fixed rate
+typedef struct ReplayFeed {
+    const char *path;         // recorded MJPEG
+    double rate;              // frames per second
+    int fd;                   // write end of the pipe, closed at the end
+} TReplayFeed;
+
+static void *feedThread(void *arg) {
+    TReplayFeed *feed = (TReplayFeed *)arg;
+    TCamStream *cs = openCameraStreamFile(feed->path);
+    const unsigned char *jpeg;
+    size_t len, off;
+    ssize_t k;
+    struct timespec next;
+    int n = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (cs && n++ < REPLAY_FRAMES && nextCameraFrame(cs, &jpeg, &len)) {
+        for (off = 0; off < len; off += k) {
+            k = write(feed->fd, jpeg + off, len - off);
+            if (k <= 0) break;
+        }
+        next.tv_nsec += (long)(1e9 / feed->rate);
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    closeCameraStream(cs);
+    close(feed->fd);
+    return NULL;
+}
+
+// Helper function for one paced replay through the pipeline; returns the
+// frames searched per second and the share of frames dropped in *drop.
+static double replayPipeline(const char *path, double rate, double *drop) {
+    const char red[3] = {255, 0, 0};
+    TReplayFeed feed;
+    TCamStream *cs;
+    TPipeline *pl;
+    pthread_t feeder;
+    unsigned long searched = 0;
+    char fdPath[32];
+    int fds[2];
+    double t0, t;
+
+    *drop = 1;
+    if (pipe(fds)) return 0;
+    feed.path = path;
+    feed.rate = rate;
+    feed.fd = fds[1];
+    snprintf(fdPath, sizeof(fdPath), "/dev/fd/%d", fds[0]);
+    cs = openCameraStreamFile(fdPath);
+    close(fds[0]);
+    if (cs == NULL || pthread_create(&feeder, NULL, feedThread, &feed)) {
+        close(fds[1]);
+        closeCameraStream(cs);
+        return 0;
+    }
+    t0 = monoTime();
+    pl = startPipeline(cs, red, FRAME_W, FRAME_H, countResult, &searched);
+    while (pl && !pipelineDone(pl)) usleep(200);
+    t = monoTime() - t0;
+    if (pl) stopPipeline(pl);
+    pthread_join(feeder, NULL);
+    *drop = 1.0 - (double)searched / cameraStreamFrames(cs);
+    closeCameraStream(cs);
+    return searched / t;
+}
+
+// Helper function comparing the frame rate of the old serial worker with the
+// pipeline on a replay of the recorded MJPEG at path.  The serial worker does
+// the work of the pipeline's stages in turn (capture, decodeJpegMemInto(),
+// followSearchBlob() with the same prune setting) as fast as it can.  A full
+// pipeline queue drops its oldest frame instead of waiting, so the pipeline
+// is fed at paced rates around the serial rate, REPLAY_REPEATS times each.
+// It sustains a rate if every repeat dropped under REPLAY_MAX_DROP of the
+// frames; the highest such rate is reported with its slowest repeat.
+static void benchReplay(const char *path) {
+    static const double factors[] = REPLAY_RATES;
+    int numRates = (int)(sizeof(factors) / sizeof(factors[0]));
+    const char red[3] = {255, 0, 0};
+    TJFramePool *pool;
+    TJImage *img;
+    TBlobFollow follow;
+    TCamStream *cs;
+    const unsigned char *jpeg;
+    size_t len;
+    double t0, serial = 0, rate, got, gotMin, drop, dropMax, best = 0;
+    int n = 0, k, j, ok;
+
+    pool = createFramePool(1, FRAME_W, FRAME_H, 3);
+    img = pool ? acquireFrame(pool) : NULL;
+    if (img == NULL) {
+        if (pool) destroyFramePool(pool);
+        return;
+    }
+    // the main thread already searches with the pipeline's prune setting
+    for (j = 0; j < REPLAY_REPEATS; j++) {
+        cs = openCameraStreamFile(path);
+        if (cs == NULL) break;
+        memset(&follow, 0, sizeof(follow));
+        n = 0;
+        t0 = monoTime();
+        while (n < REPLAY_FRAMES && nextCameraFrame(cs, &jpeg, &len)) {
+            if (decodeJpegMemInto(jpeg, len, img) == 0) followSearchBlob(&follow, red, img);
+            n++;
+        }
+        serial += n / (monoTime() - t0) / REPLAY_REPEATS;
+        closeCameraStream(cs);
+    }
+    releaseFrame(img);
+    destroyFramePool(pool);
+    if (j < REPLAY_REPEATS) return;
+
+    printf("replay of %d frames, %ld CPUs: serial worker %.0f fps | pipeline fed at", n,
+           sysconf(_SC_NPROCESSORS_ONLN), serial);
+    for (k = 0; k < numRates; k++) {
+        rate = serial * factors[k];
+        gotMin = 0;
+        dropMax = 0;
+        for (j = 0; j < REPLAY_REPEATS; j++) {
+            got = replayPipeline(path, rate, &drop);
+            if (j == 0 || got < gotMin) gotMin = got;
+            if (drop > dropMax) dropMax = drop;
+        }
+        ok = dropMax < REPLAY_MAX_DROP;
+        printf(" %.0f: %.0f fps %.1f%% dropped%s%s", rate, gotMin, dropMax * 100, ok ? "" : " (fails)",
+               k + 1 < numRates ? "," : "");
+        if (ok) best = gotMin;  // REPLAY_RATES rise
+    }
+    printf(" | worst of %d repeats | sustained %.0f fps, %.2fx the serial worker\n", REPLAY_REPEATS,
+           best, best / serial);
+}
+
+// Helper function for one run of the given controller.
+// The JPEGs of the run are appended to record unless it is NULL.
+static void runBench(int ctrl, int frames, double noise, unsigned int seed, double fps, TJImage *img,
+                     TBenchRun *r, TWindowBench *wb, FILE *record) {
+    const char red[3] = {255, 0, 0};
+    int stepsPerFrame = (int)(CTRL_RATE / fps + 0.5);
+    int delaySteps = (int)(RESULT_DELAY * CTRL_RATE + 0.5);
+    TSimWorld w;
+    TBlobTrack tr;
+    TBlobPredict pr;
+    TBlobSearch blob, pending[PENDING_LEN], held;
+    unsigned char *jpeg;
+    unsigned long len;
+    double t0, u, width, turn, drive, halign, size, lastTurn = 0, trueH;
+    double pendingT[PENDING_LEN], pendingHeading[PENDING_LEN];
+    int i, step, visible, haveBlob, head = 0, tail = 0, due[PENDING_LEN];
+
+    if (stepsPerFrame < 1) stepsPerFrame = 1;
+    simWorldInit(&w, LEAD_SPEED, noise, seed);
+    initBlobTrack(&tr, TRACK_HALIGN_PER_RAD);
+    memset(&held, 0, sizeof(held));
+
+    for (i = 0, step = 0; i < frames; step++) {
+        // camera: take a picture, its result arrives RESULT_DELAY later
+        if (step % stepsPerFrame == 0) {
+            simRender(&w, img);
+            if (wb) benchWindow(img, i, wb);
+            len = simEncodeJpeg(img, JPEG_QUALITY, &jpeg);
+            if (record) fwrite(jpeg, 1, len, record);
+            visible = simLeadInView(&w, FRAME_W, &u, &width);
+
+            t0 = monoTime();
+            blob = jpegMemSearchBlob(jpeg, len, red);
+            r->lat[i] = monoTime() - t0;
+            r->busy += r->lat[i];
+            free(jpeg);
+
+            if (visible) r->nVisible++;
+            if (blob.size > 0 && visible) {
+                r->nHit++;
+                r->errSum += fabs(blob.blob.center_x - u);
+                r->errMax = fmax(r->errMax, fabs(blob.blob.center_x - u));
+            } else if (blob.size > 0) {
+                r->nFalse++;
+            }
+            pending[tail % PENDING_LEN] = blob;
+            pendingT[tail % PENDING_LEN] = w.t;
+            pendingHeading[tail % PENDING_LEN] = w.car.th;
+            due[tail % PENDING_LEN] = step + delaySteps;
+            tail++;
+            i++;
+        }
+        while (head < tail && step >= due[head % PENDING_LEN]) {
+            held = pending[head % PENDING_LEN];
+            updateBlobTrack(&tr, &held, pendingT[head % PENDING_LEN], pendingHeading[head % PENDING_LEN]);
+            head++;
+        }
+
+        // controller input: latest result or prediction for now
+        if (ctrl == CTRL_TRACK) {
+            predictBlobTrack(&tr, w.t, w.car.th, &pr);
+            haveBlob = pr.conf >= TRACK_MIN_CONF && pr.size > 0;
+            halign = pr.halign;
+            size = pr.size;
+        } else {
+            haveBlob = held.size > 0;
+            halign = held.halign;
+            size = held.size;
+        }
+
+        if (simLeadInView(&w, FRAME_W, &u, &width)) {
+            r->inView++;
+            trueH = -1.0 + 2.0 * u / FRAME_W;
+            if (haveBlob) {
+                r->estErr[r->nEst] = fabs(halign - trueH) * FRAME_W / 2;
+                r->estSum += r->estErr[r->nEst++];
+            }
+        }
+
+        // follow the lead vehicle, or spin to search for it
+        if (haveBlob) {
+            turn = K_TURN * halign;
+            drive = fmax(-40, fmin(40, K_DRIVE * (TARGET_WIDTH - BLOB_WIDTH(size))));
+            simSetMotors(&w, drive + turn, drive - turn);
+            r->steerSum += fabs(turn - lastTurn);
+            r->steerMax = fmax(r->steerMax, fabs(turn - lastTurn));
+            if (turn * lastTurn < 0) r->reversals++;
+            r->nSteer++;
+            lastTurn = turn;
+        } else {
+            simSetMotors(&w, -30, 30);
+            lastTurn = 0;
+        }
+        simWorldStep(&w, 1.0 / CTRL_RATE);
+        r->distSum += hypot(w.lead.x - w.car.x, w.lead.y - w.car.y);
+        r->steps++;
+    }
+    r->collisions = w.collisions;
+}
+
+int main(int argc, char *argv[]) {
+    int frames = argc > 1 ? atoi(argv[1]) : 3000;
+    double noise = argc > 2 ? atof(argv[2]) : 0.0;
+    unsigned int seed = argc > 3 ? atoi(argv[3]) : 1;
+    double fps = argc > 4 ? atof(argv[4]) : 30;
+    static const char *names[2] = { "hold", "track" };
+    TJImage img = {0};
+    TBenchRun run[2] = {{0}}, *r;
+    TWindowBench wb = {0};
+    char recordPath[] = "/tmp/simbench-XXXXXX";
+    FILE *record;
+    double busy[2];
+    int c, maxSteps;
+
+    maxSteps = (int)(frames * (CTRL_RATE / (fps > 0 ? fps : 1) + 1)) + 1;
+    img.w = FRAME_W;
+    img.h = FRAME_H;
+    img.numChannels = 3;
+    img.data = (unsigned char *)malloc(FRAME_W * FRAME_H * 3);
+    for (c = 0; c < 2; c++) {
+        run[c].lat = (double *)malloc((frames > 0 ? frames : 1) * sizeof(double));
+        run[c].estErr = (double *)malloc(maxSteps * sizeof(double));
+    }
+    wb.full = (double *)malloc((frames > 0 ? frames : 1) * sizeof(double));
+    wb.win = (double *)malloc((frames > 0 ? frames : 1) * sizeof(double));
+    if (run[0].lat == NULL || run[1].lat == NULL || run[0].estErr == NULL || run[1].estErr == NULL ||
+        wb.full == NULL || wb.win == NULL || img.data == NULL || frames <= 0 || fps <= 0 || fps > CTRL_RATE || RESULT_DELAY * fps >= PENDING_LEN - 1) {
+        fprintf(stderr, "usage: %s [frames [noise [seed [fps]]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    setBlobSearchPrune(PIPE_MIN_BLOB, 0);
+    record = fdopen(mkstemp(recordPath), "w+");
+    for (c = 0; c < 2; c++) runBench(c, frames, noise, seed, fps, &img, &run[c], c == 0 ? &wb : NULL,
+                                     c == 0 ? record : NULL);
+    if (record) fclose(record);
+
+    r = &run[CTRL_HOLD];
+    qsort(r->lat, frames, sizeof(double), cmpDouble);
+    printf("frames %d at %.1f fps (%.1f s simulated), control %d Hz, result delay %.0f ms, noise %.0f, seed %u\n",
+           frames, fps, r->steps / (double)CTRL_RATE, CTRL_RATE, RESULT_DELAY * 1e3, noise, seed);
+    printf("detector: %.0f fps, latency p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+           frames / r->busy, r->lat[frames / 2] * 1e3, r->lat[frames * 99 / 100] * 1e3, r->lat[frames - 1] * 1e3);
+    printf("detection: %d of %d frames with the lead in view (%.1f%%), %d false positives\n",
+           r->nHit, r->nVisible, r->nVisible ? 100.0 * r->nHit / r->nVisible : 0.0, r->nFalse);
+    printf("centre error: mean %.2f px, max %.2f px\n", r->nHit ? r->errSum / r->nHit : 0.0, r->errMax);
+
+    qsort(wb.full, frames, sizeof(double), cmpDouble);
+    qsort(wb.win, frames, sizeof(double), cmpDouble);
+    for (c = 0, busy[0] = busy[1] = 0; c < frames; c++) {
+        busy[0] += wb.full[c];
+        busy[1] += wb.win[c];
+    }
+    printf("search of the decoded frame: whole %.1f us (p50 %.1f), window %.1f us (p50 %.1f), %.1fx faster | "
+           "pixels %.0f vs %.0f | %lu of %d searched whole | same result in %d of %d frames\n",
+           busy[0] / frames * 1e6, wb.full[frames / 2] * 1e6, busy[1] / frames * 1e6, wb.win[frames / 2] * 1e6,
+           busy[0] / busy[1], wb.pixFull / frames, wb.pixWin / frames, wb.follow.full, frames, wb.same, frames);
+
+    for (c = 0; c < 2; c++) {
+        r = &run[c];
+        qsort(r->estErr, r->nEst, sizeof(double), cmpDouble);
+        printf("%-5s: steering error mean %.2f px, p95 %.2f px | turn change mean %.2f, max %.2f, reversals %d | "
+               "lead in view %.1f%%, mean distance %.2f m, collisions %d\n", names[c],
+               r->nEst ? r->estSum / r->nEst : 0.0, r->nEst ? r->estErr[r->nEst * 95 / 100] : 0.0,
+               r->nSteer ? r->steerSum / r->nSteer : 0.0, r->steerMax, r->reversals,
+               100.0 * r->inView / r->steps, r->distSum / r->steps, r->collisions);
+    }
+
+    benchReplay(recordPath);
+    unlink(recordPath);
+    benchPyramid(noise, seed);
+    benchPacked(noise, seed);
+
+    for (c = 0; c < 2; c++) {
+        free(run[c].lat);
+        free(run[c].estErr);
+    }
+    free(wb.full);
+    free(wb.win);
+    free(img.data);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,446 @@
+//======================================================================
+//
+// Benchmark of the quickblob engines on synthetic masks.  Labels noise,
+// stripes and one large blob with the sibling lists, the union-find
+// labeller and the band engine, at 4- and 8-connectivity, from byte and
+// from packed rows, checks that all of them find the same blobs and
+// prints time and buffer size.  Then times the band engine with 1 to
+// BENCH_THREADS threads over several resolutions, checking its blobs
+// against the serial engine's.  The row scan is timed on its own too: the
+// run scanners of quickblob.c, called through quickblob_run_end() (byte
+// loop, words, SSE2, AVX2 or NEON, whichever the build and the machine
+// have) over short, long and mixed runs.  With
+// -j, the search of detect_blob.c must also give the same result on the
+// picture with 1 to BENCH_THREADS threads.
+//
+// usage: blobbench [-j picture.jpg] [width height [repeat]]
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "quickblob.h"
+#include "detect_blob.h"
+
+#define BAND_THREADS 4
+
+// Thread sweep: most threads, and the frame sizes
+#define BENCH_THREADS 4
+#define BENCH_SIZES { { 320, 240 }, { 640, 480 }, { 1280, 960 }, { 1920, 1080 } }
+
+// One mask and the blobs found in it
+typedef struct Bench {
+  const unsigned char *mask;
+  const uint64_t *packed;  // the mask 64 pixels per word, rows start on a word
+  int w, h, words;
+  int frames;              // frames left in the current run
+  struct blob *blobs;      // blobs of the current frame
+  int n, cap;
+} TBench;
+
+// Hooks of the bench extractors (detect_blob.c has the global ones)
+static void benchLogBlob(void *user, struct blob *b) {
+  TBench *bench = (TBench *)user;
+  if (bench->n < bench->cap) bench->blobs[bench->n++] = *b;
+}
+
+static int benchInitStream(void *user, struct stream_state *stream) {
+  TBench *bench = (TBench *)user;
+  stream->w = bench->w;
+  stream->h = bench->h;
+  return 0;
+}
+
+static int benchCloseStream(void *user, struct stream_state *stream) {
+  (void)user;
+  (void)stream;
+  return 0;
+}
+
+// Whole frames only, the bench sets no windows (stream->x0 is 0)
+static int benchNextRow(void *user, struct stream_state *stream) {
+  TBench *bench = (TBench *)user;
+  if (stream->packed) {
+    memcpy(stream->bits, bench->packed + (long)stream->y * bench->words, bench->words * sizeof(uint64_t));
+    return 0;
+  }
+  memcpy(stream->row, bench->mask + (long)stream->y * bench->w + stream->x0, stream->w);
+  return 0;
+}
+
+static int benchNextFrame(void *user, struct stream_state *stream) {
+  TBench *bench = (TBench *)user;
+  (void)stream;
+  if (bench->frames-- <= 0) return 1;
+  bench->n = 0;
+  return 0;
+}
+
+static const struct quickblob_hooks bench_hooks = {
+  benchLogBlob, benchInitStream, benchCloseStream,
+  benchNextRow, benchNextFrame, NULL
+};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Orders blobs by everything the engines must agree on
+static int cmpBlob(const void *a, const void *b) {
+  const struct blob *x = (const struct blob *)a, *y = (const struct blob *)b;
+  if (x->bb_y1 != y->bb_y1) return x->bb_y1 - y->bb_y1;
+  if (x->bb_x1 != y->bb_x1) return x->bb_x1 - y->bb_x1;
+  if (x->color != y->color) return x->color - y->color;
+  if (x->size != y->size) return x->size - y->size;
+  if (x->sum_x != y->sum_x) return x->sum_x < y->sum_x ? -1 : 1;
+  return x->sum_y < y->sum_y ? -1 : x->sum_y > y->sum_y;
+}
+
+static int sameBlobs(const struct blob *a, const struct blob *b, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    if (cmpBlob(&a[i], &b[i]) || a[i].bb_x2 != b[i].bb_x2 || a[i].bb_y2 != b[i].bb_y2 ||
+        a[i].sum_xx != b[i].sum_xx || a[i].sum_yy != b[i].sum_yy || a[i].sum_xy != b[i].sum_xy)
+      return 0;
+  }
+  return 1;
+}
+
+// Labels the mask repeat times, returns microseconds per frame
+// The blobs of the last frame are left sorted in bench->blobs
+static double runEngine(TBench *bench, int engine, int connectivity, int threads,
+                        int input, int repeat, long *bytes) {
+  struct extractor ex;
+  double t0, t1;
+  if (extractor_init(&ex, &bench_hooks, bench->w) ||
+      extractor_set_engine(&ex, engine, connectivity) ||
+      extractor_set_threads(&ex, threads) || extractor_set_input(&ex, input)) {
+    fprintf(stderr, "blobbench: cannot set up the extractor\n");
+    exit(1);
+  }
+  // one untimed frame allocates the engine buffers
+  bench->frames = 1;
+  extractor_run(&ex, bench);
+  bench->frames = repeat;
+  t0 = now();
+  extractor_run(&ex, bench);
+  t1 = now();
+  *bytes = extractor_bytes(&ex);
+  extractor_free(&ex);
+  qsort(bench->blobs, bench->n, sizeof(struct blob), cmpBlob);
+  return (t1 - t0) * 1e6 / repeat;
+}
+
+static void makeNoise(unsigned char *m, int w, int h) {
+  long i;
+  srand(1);
+  for (i = 0; i < (long)w * h; i++) m[i] = rand() & 1;
+}
+
+// Vertical stripes 3 pixels wide, every 16th row a bridge joins them
+static void makeStripes(unsigned char *m, int w, int h) {
+  int x, y;
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++)
+      m[(long)y * w + x] = (x % 6) < 3 || (y % 16) == 0;
+}
+
+// One disc filling most of the picture
+static void makeDisc(unsigned char *m, int w, int h) {
+  int x, y, r = (w < h ? w : h) * 2 / 5;
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++)
+      m[(long)y * w + x] = (x - w / 2) * (x - w / 2) + (y - h / 2) * (y - h / 2) <= r * r;
+}
+
+// Squares of 6x6 pixels every 10 pixels, many blobs of some size
+static void makeGrid(unsigned char *m, int w, int h) {
+  int x, y;
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++)
+      m[(long)y * w + x] = (x % 10) < 6 && (y % 10) < 6;
+}
+
+// Packs the 0/1 mask row by row
+static void packMask(const unsigned char *m, uint64_t *p, int w, int h, int words) {
+  int x, y;
+  memset(p, 0, (long)h * words * sizeof(uint64_t));
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++)
+      p[(long)y * words + x / 64] |= (uint64_t)m[(long)y * w + x] << (x % 64);
+}
+
+// Labels the current mask with one engine from both inputs, the results must match ref
+static int runBoth(TBench *bench, int engine, int conn, int threads, int repeat,
+                   const struct blob *ref, int n_ref, double t[2], long *bytes) {
+  int same;
+  t[0] = runEngine(bench, engine, conn, threads, QUICKBLOB_BYTES, repeat, bytes);
+  same = bench->n == n_ref && sameBlobs(ref, bench->blobs, n_ref);
+  t[1] = runEngine(bench, engine, conn, threads, QUICKBLOB_BITS, repeat, bytes);
+  return same && bench->n == n_ref && sameBlobs(ref, bench->blobs, n_ref);
+}
+
+// Times the band engine with 1 to BENCH_THREADS threads on a grid and a disc
+// at every size of BENCH_SIZES, each result checked against the serial one
+static void benchThreads(int repeat) {
+  static const int sizes[][2] = BENCH_SIZES;
+  static const char *names[] = { "grid", "disc" };
+  static void (*makers[])(unsigned char *, int, int) = { makeGrid, makeDisc };
+  TBench bench;
+  struct blob *ref;
+  unsigned char *mask;
+  double t[BENCH_THREADS + 1];
+  long bytes;
+  int s, k, n, reps, n_ref, same;
+
+  printf("\nband engine, %ld CPUs online, time in us per frame (speedup over 1 thread), same blobs as 1 thread\n",
+         sysconf(_SC_NPROCESSORS_ONLN));
+  printf("%-8s %9s", "mask", "size");
+  for (n = 1; n <= BENCH_THREADS; n++) printf(" %11d thr", n);
+  printf(" %4s\n", "same");
+  for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+    bench.w = sizes[s][0];
+    bench.h = sizes[s][1];
+    bench.words = (bench.w + 63) / 64;
+    // a square per 100 pixels and the background
+    bench.cap = bench.w * bench.h / 100 + 16;
+    mask = (unsigned char *)malloc((long)bench.w * bench.h);
+    bench.blobs = (struct blob *)malloc(bench.cap * sizeof(struct blob));
+    ref = (struct blob *)malloc(bench.cap * sizeof(struct blob));
+    if (!mask || !bench.blobs || !ref) {
+      fprintf(stderr, "blobbench: out of memory\n");
+      exit(1);
+    }
+    bench.mask = mask;
+    bench.packed = NULL;
+    // about the same pixels per run at every size
+    reps = (int)((long)repeat * 640 * 480 / ((long)bench.w * bench.h));
+    if (reps < 1) reps = 1;
+    for (k = 0; k < 2; k++) {
+      makers[k](mask, bench.w, bench.h);
+      t[1] = runEngine(&bench, QUICKBLOB_LISTS, 4, 1, QUICKBLOB_BYTES, reps, &bytes);
+      n_ref = bench.n;
+      memcpy(ref, bench.blobs, n_ref * sizeof(struct blob));
+      same = 1;
+      for (n = 2; n <= BENCH_THREADS; n++) {
+        t[n] = runEngine(&bench, QUICKBLOB_LISTS, 4, n, QUICKBLOB_BYTES, reps, &bytes);
+        same = same && bench.n == n_ref && sameBlobs(ref, bench.blobs, n_ref);
+      }
+      printf("%-8s %4dx%-4d", names[k], bench.w, bench.h);
+      for (n = 1; n <= BENCH_THREADS; n++) printf(" %8.0f %4.2fx", t[n], t[1] / t[n]);
+      printf(" %4s\n", same ? "yes" : "NO");
+    }
+    free(mask);
+    free(bench.blobs);
+    free(ref);
+  }
+}
+
+// Runs of random length lo..hi, alternately 0 and 1, carried over the rows;
+// with lo2 > 0 each run takes one of the lengths lo..hi or lo2..hi2 at random
+static void makeRuns(unsigned char *m, int w, int h, int lo, int hi, int lo2, int hi2) {
+  long i = 0, n, len;
+  unsigned char c = 0;
+  srand(2);
+  while (i < (long)w * h) {
+    if (lo2 > 0 && (rand() & 1)) len = lo2 + rand() % (hi2 - lo2 + 1);
+    else len = lo + rand() % (hi - lo + 1);
+    for (n = 0; n < len && i < (long)w * h; n++) m[i++] = c;
+    c ^= 1;
+  }
+}
+
+// Splits every row of the mask into runs with one scanner repeat times,
+// returns microseconds per frame; *sum gets the sum of the run ends
+static double runScan(int scanner, const unsigned char *m, int w, int h, int repeat, long *sum) {
+  const unsigned char *row;
+  double t0, t1;
+  long ends = 0;
+  int r, y, x;
+  t0 = now();
+  for (r = 0; r < repeat; r++) {
+    for (y = 0; y < h; y++) {
+      row = m + (long)y * w;
+      for (x = 0; x < w; x = quickblob_run_end(scanner, row, x + 1, w, row[x])) ends += x;
+    }
+  }
+  t1 = now();
+  *sum = ends / repeat;
+  return (t1 - t0) * 1e6 / repeat;
+}
+
+// Times the run scanners on rows of short, long and mixed runs; the one the
+// labelling loop was built with is marked with a *
+static void benchScan(int w, int h, int repeat) {
+  static const char *names[] = { "1-3 px", "50-300 px", "mixed" };
+  static const int lengths[][4] = { { 1, 3, 0, 0 }, { 50, 300, 0, 0 }, { 1, 3, 50, 300 } };
+  static const struct {
+    const char *name;
+    int scanner;
+  } variants[] = {
+    { "byte loop", QUICKBLOB_SCAN_BYTES },
+    { "words", QUICKBLOB_SCAN_WORDS },
+    { "SSE2", QUICKBLOB_SCAN_SSE2 },
+    { "AVX2", QUICKBLOB_SCAN_AVX2 },
+    { "NEON", QUICKBLOB_SCAN_NEON },
+  };
+  int nv = (int)(sizeof(variants) / sizeof(variants[0]));
+  unsigned char *m = (unsigned char *)malloc((long)w * h);
+  unsigned char probe[2] = { 0, 1 };
+  char name[16];
+  long ref = 0, sum;
+  double t;
+  int k, v, same;
+
+  if (!m) {
+    fprintf(stderr, "blobbench: out of memory\n");
+    exit(1);
+  }
+  printf("\nrow scan, %dx%d, time in us per frame, same runs as the byte loop, - not in this build\n",
+         w, h);
+  printf("%-10s", "runs");
+  for (v = 0; v < nv; v++) {
+    snprintf(name, sizeof(name), "%s%s", variants[v].name,
+             variants[v].scanner == quickblob_scanner() ? "*" : "");
+    printf(" %10s", name);
+  }
+  printf(" %4s\n", "same");
+  for (k = 0; k < 3; k++) {
+    makeRuns(m, w, h, lengths[k][0], lengths[k][1], lengths[k][2], lengths[k][3]);
+    printf("%-10s", names[k]);
+    same = 1;
+    for (v = 0; v < nv; v++) {
+      if (quickblob_run_end(variants[v].scanner, probe, 0, 2, 0) < 0) {
+        printf(" %10s", "-");
+        continue;
+      }
+      t = runScan(variants[v].scanner, m, w, h, repeat, &sum);
+      if (v == 0) ref = sum;
+      same = same && sum == ref;
+      printf(" %10.0f", t);
+    }
+    printf(" %4s\n", same ? "yes" : "NO");
+  }
+  free(m);
+}
+
+// Tells if two searches found the same blob
+static int sameSearch(const TBlobSearch *a, const TBlobSearch *b) {
+  return a->size == b->size && a->halign == b->halign && a->valign == b->valign &&
+         a->blob.color == b->blob.color && a->blob.sum_x == b->blob.sum_x && a->blob.sum_y == b->blob.sum_y &&
+         a->blob.sum_xx == b->blob.sum_xx && a->blob.sum_yy == b->blob.sum_yy && a->blob.sum_xy == b->blob.sum_xy &&
+         a->blob.bb_x1 == b->blob.bb_x1 && a->blob.bb_y1 == b->blob.bb_y1 &&
+         a->blob.bb_x2 == b->blob.bb_x2 && a->blob.bb_y2 == b->blob.bb_y2 &&
+         a->blob.center_x == b->blob.center_x && a->blob.center_y == b->blob.center_y;
+}
+
+// Searches the picture for the largest blobs of red, green and blue with 1 to
+// BENCH_THREADS threads; every thread count must give the 1-thread result
+static int checkPicture(const char *fname) {
+  static const char colors[3][3] = { { 255, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 } };
+  TBlobSearch ref[3 * BLOB_MAX_TOPK], res[3 * BLOB_MAX_TOPK];
+  TJImage img;
+  FILE *f = fopen(fname, "rb");
+  int n, i, found = 0, same = 1;
+
+  if (f == NULL) {
+    fprintf(stderr, "blobbench: cannot open %s\n", fname);
+    return 1;
+  }
+  img = read_JPEG_image(f);
+  fclose(f);
+  setBlobSearchThreads(1);
+  imageSearchBlobs(colors, 3, BLOB_MAX_TOPK, &img, ref);
+  for (i = 0; i < 3 * BLOB_MAX_TOPK; i++) found += ref[i].size > 0;
+  for (n = 2; n <= BENCH_THREADS; n++) {
+    setBlobSearchThreads(n);
+    imageSearchBlobs(colors, 3, BLOB_MAX_TOPK, &img, res);
+    for (i = 0; i < 3 * BLOB_MAX_TOPK; i++) same = same && sameSearch(&ref[i], &res[i]);
+  }
+  setBlobSearchThreads(1);
+  printf("\n%s (%dx%d): %d blobs, largest red %d px, 2-%d threads give the 1-thread result: %s\n",
+         fname, img.w, img.h, found, ref[0].size, BENCH_THREADS, same ? "yes" : "NO");
+  free(img.data);
+  freeBlobSearch();
+  return !same;
+}
+
+int main(int argc, char *argv[]) {
+  static const char *names[] = { "noise", "stripes", "disc" };
+  static void (*makers[])(unsigned char *, int, int) = { makeNoise, makeStripes, makeDisc };
+  const char *picture = NULL;
+  int w, h, repeat;
+  TBench bench;
+  struct blob *ref;
+  unsigned char *mask;
+  uint64_t *packed;
+  double t_lists[2], t_uf[2], t_bands[2];
+  long b_lists, b_uf, b_bands;
+  int k, conn, n_ref, same;
+
+  if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+    picture = argv[2];
+    argc -= 2;
+    argv += 2;
+  }
+  w = argc > 2 ? atoi(argv[1]) : 640;
+  h = argc > 2 ? atoi(argv[2]) : 480;
+  repeat = argc > 3 ? atoi(argv[3]) : 50;
+  if (w <= 0 || h <= 0 || repeat <= 0) {
+    fprintf(stderr, "usage: blobbench [-j picture.jpg] [width height [repeat]]\n");
+    return 1;
+  }
+  bench.words = (w + 63) / 64;
+  mask = (unsigned char *)malloc((long)w * h);
+  packed = (uint64_t *)malloc((long)h * bench.words * sizeof(uint64_t));
+  // a 4-connected checkerboard has the most blobs, one per pixel
+  bench.cap = (int)((long)w * h);
+  bench.blobs = (struct blob *)malloc(bench.cap * sizeof(struct blob));
+  ref = (struct blob *)malloc(bench.cap * sizeof(struct blob));
+  if (!mask || !packed || !bench.blobs || !ref) {
+    fprintf(stderr, "blobbench: out of memory\n");
+    return 1;
+  }
+  bench.mask = mask;
+  bench.packed = packed;
+  bench.w = w;
+  bench.h = h;
+
+  printf("%dx%d, %d frames per run, time in us per frame (byte rows / packed rows), buffers in KiB\n",
+         w, h, repeat);
+  printf("%-8s %4s %7s %17s %17s %17s %6s %6s %4s\n", "mask", "conn", "blobs",
+         "lists", "unionfind", "bands", "lists", "uf", "same");
+  for (k = 0; k < 3; k++) {
+    makers[k](mask, w, h);
+    packMask(mask, packed, w, h, bench.words);
+    for (conn = 4; conn <= 8; conn += 4) {
+      // the lists from byte rows are the reference
+      runEngine(&bench, QUICKBLOB_LISTS, conn, 1, QUICKBLOB_BYTES, 1, &b_lists);
+      n_ref = bench.n;
+      memcpy(ref, bench.blobs, n_ref * sizeof(struct blob));
+      same = runBoth(&bench, QUICKBLOB_LISTS, conn, 1, repeat, ref, n_ref, t_lists, &b_lists);
+      same = runBoth(&bench, QUICKBLOB_UNION_FIND, conn, 1, repeat, ref, n_ref, t_uf, &b_uf) && same;
+      same = runBoth(&bench, QUICKBLOB_LISTS, conn, BAND_THREADS, repeat, ref, n_ref, t_bands, &b_bands) && same;
+      printf("%-8s %4d %7d %8.0f /%7.0f %8.0f /%7.0f %8.0f /%7.0f %6.1f %6.1f %4s\n", names[k], conn, n_ref,
+             t_lists[0], t_lists[1], t_uf[0], t_uf[1], t_bands[0], t_bands[1],
+             b_lists / 1024.0, b_uf / 1024.0, same ? "yes" : "NO");
+    }
+  }
+  free(mask);
+  free(packed);
+  free(bench.blobs);
+  free(ref);
+
+  benchScan(w, h, repeat);
+  benchThreads(repeat);
+  return picture ? checkPicture(picture) : 0;
+}
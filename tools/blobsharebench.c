@@ -0,0 +1,258 @@
+//======================================================================
+//
+// Stress test of blob_share.c.  One writer publishes results back to
+// back while one reader polls for them, each thread pinned to its own
+// CPU.  Times every publish and every read and prints the latency
+// percentiles, next to the same run through a mutex-protected result
+// (the count_mutex scheme blob_share replaced).  Every result read must
+// be whole (all fields from one publish) and no older than the one read
+// before.
+//
+// usage: blobsharebench [-w cpu] [-r cpu] [operations]
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include "blob_share.h"
+#include "periodic.h"
+
+// Latency histogram: 1 ns bins, slower operations go to the last bin
+#define HIST_NS 4096
+
+// A result guarded by a mutex, as camcar shared it before blob_share
+typedef struct MutexShare {
+  pthread_mutex_t lock;
+  TBlobSearch blob;
+  unsigned long seq;
+  double t;
+} TMutexShare;
+
+// One way of sharing the result
+typedef struct ShareOps {
+  const char *name;
+  void (*publish)(void *share, const TBlobSearch *blob, unsigned long seq, double t);
+  unsigned long (*read)(void *share, TBlobSearch *blob, double *t);
+} TShareOps;
+
+// Latencies of one side
+typedef struct Hist {
+  unsigned long count[HIST_NS];
+  unsigned long n;
+  long long max;
+} THist;
+
+// State of one run, shared by the two threads
+typedef struct Run {
+  const TShareOps *ops;
+  void *share;
+  unsigned long operations;  // results published
+  int cpu[2];                // CPU of the writer and of the reader
+  int pinned[2];             // the thread is pinned to its CPU
+  int ranOn[2];              // CPU the thread ended on
+  pthread_barrier_t start;
+  THist hist[2];             // publish and read latencies
+  unsigned long reads;       // reads done, fresh or not
+  unsigned long torn;        // results mixing fields of two publishes
+  unsigned long backwards;   // results older than the one read before
+} TRun;
+
+static void mutexPublish(void *share, const TBlobSearch *blob, unsigned long seq, double t) {
+  TMutexShare *ms = (TMutexShare *)share;
+  pthread_mutex_lock(&ms->lock);
+  ms->blob = *blob;
+  ms->seq = seq;
+  ms->t = t;
+  pthread_mutex_unlock(&ms->lock);
+}
+
+static unsigned long mutexRead(void *share, TBlobSearch *blob, double *t) {
+  TMutexShare *ms = (TMutexShare *)share;
+  unsigned long seq;
+  pthread_mutex_lock(&ms->lock);
+  *blob = ms->blob;
+  *t = ms->t;
+  seq = ms->seq;
+  pthread_mutex_unlock(&ms->lock);
+  return seq;
+}
+
+static void triplePublish(void *share, const TBlobSearch *blob, unsigned long seq, double t) {
+  publishBlobResult((TBlobShare *)share, blob, seq, t);
+}
+
+static unsigned long tripleRead(void *share, TBlobSearch *blob, double *t) {
+  return readBlobResult((TBlobShare *)share, blob, t);
+}
+
+static const TShareOps share_ops[] = {
+  { "mutex", mutexPublish, mutexRead },
+  { "triple buffer", triplePublish, tripleRead },
+};
+
+static void histAdd(THist *h, long long ns) {
+  h->count[ns < HIST_NS - 1 ? ns : HIST_NS - 1]++;
+  h->n++;
+  if (ns > h->max) h->max = ns;
+}
+
+// Smallest latency (ns) that the fraction p of the operations did not exceed
+static long histPercentile(const THist *h, double p) {
+  unsigned long need = (unsigned long)(p * h->n), sum = 0;
+  long i;
+  for (i = 0; i < HIST_NS - 1; i++) {
+    sum += h->count[i];
+    if (sum >= need) return i;
+  }
+  return (long)h->max;
+}
+
+// Fills every field of the result from its number, so a torn one shows
+static void makeResult(TBlobSearch *b, unsigned long seq) {
+  memset(b, 0, sizeof(TBlobSearch));
+  b->size = (int)seq;
+  b->halign = seq * 0.5;
+  b->valign = -(double)seq;
+  b->blob.size = (int)seq;
+  b->blob.sum_x = 3.0 * seq;
+  b->blob.bb_x2 = (int)(seq & 0xffff);
+}
+
+static int wholeResult(const TBlobSearch *b, unsigned long seq, double t) {
+  return b->size == (int)seq && b->halign == seq * 0.5 && b->valign == -(double)seq &&
+         b->blob.size == (int)seq && b->blob.sum_x == 3.0 * seq &&
+         b->blob.bb_x2 == (int)(seq & 0xffff) && t == (double)seq;
+}
+
+// Pins the calling thread, side 0 is the writer and 1 the reader
+static void pinSide(TRun *run, int side) {
+  run->pinned[side] = (setThreadRealtime(pthread_self(), 0, 1UL << run->cpu[side]) & RT_PINNED) != 0;
+  pthread_barrier_wait(&run->start);
+}
+
+static void *writerThread(void *arg) {
+  TRun *run = (TRun *)arg;
+  TBlobSearch b;
+  unsigned long seq;
+  long long t0, t1;
+
+  pinSide(run, 0);
+  for (seq = 1; seq <= run->operations; seq++) {
+    makeResult(&b, seq);
+    t0 = monoTimeNs();
+    run->ops->publish(run->share, &b, seq, (double)seq);
+    t1 = monoTimeNs();
+    histAdd(&run->hist[0], t1 - t0);
+  }
+  run->ranOn[0] = sched_getcpu();
+  return NULL;
+}
+
+static void *readerThread(void *arg) {
+  TRun *run = (TRun *)arg;
+  TBlobSearch b;
+  unsigned long seq = 0, last = 0;
+  long long t0, t1;
+  double t;
+
+  pinSide(run, 1);
+  while (last < run->operations) {
+    t0 = monoTimeNs();
+    seq = run->ops->read(run->share, &b, &t);
+    t1 = monoTimeNs();
+    histAdd(&run->hist[1], t1 - t0);
+    run->reads++;
+    if (seq == 0) continue;  // nothing published yet
+    if (!wholeResult(&b, seq, t)) run->torn++;
+    if (seq < last) run->backwards++;
+    last = seq;
+  }
+  run->ranOn[1] = sched_getcpu();
+  return NULL;
+}
+
+// Runs one writer and one reader on the share, returns 0 on success
+static int runShare(TRun *run) {
+  pthread_t thread[2];
+
+  pthread_barrier_init(&run->start, NULL, 2);
+  if (pthread_create(&thread[0], NULL, writerThread, run) != 0) return -1;
+  // without a reader the writer waits at the barrier until the bench exits
+  if (pthread_create(&thread[1], NULL, readerThread, run) != 0) return -1;
+  pthread_join(thread[0], NULL);
+  pthread_join(thread[1], NULL);
+  pthread_barrier_destroy(&run->start);
+  return 0;
+}
+
+static void printHist(const char *name, const char *side, const THist *h) {
+  printf("%-14s %-8s %9lu %7ld %7ld %7ld %9lld\n", name, side, h->n,
+         histPercentile(h, 0.5), histPercentile(h, 0.99), histPercentile(h, 0.999), h->max);
+}
+
+int main(int argc, char *argv[]) {
+  static TMutexShare ms = { PTHREAD_MUTEX_INITIALIZER };
+  static TBlobShare bs;
+  void *shares[2] = { &ms, &bs };
+  int cpu[2] = { 0, 1 };
+  unsigned long operations = 2000000;
+  int opt, k, ok = 1;
+  TRun *run;
+
+  while ((opt = getopt(argc, argv, "w:r:")) != -1) {
+    if (opt == 'w' && atoi(optarg) >= 0 && atoi(optarg) < 64) {
+      cpu[0] = atoi(optarg);
+    } else if (opt == 'r' && atoi(optarg) >= 0 && atoi(optarg) < 64) {
+      cpu[1] = atoi(optarg);
+    } else {
+      fprintf(stderr, "usage: blobsharebench [-w cpu] [-r cpu] [operations]\n");
+      return 1;
+    }
+  }
+  if (optind < argc) operations = strtoul(argv[optind], NULL, 10);
+  if (operations == 0) {
+    fprintf(stderr, "usage: blobsharebench [-w cpu] [-r cpu] [operations]\n");
+    return 1;
+  }
+  run = (TRun *)malloc(sizeof(TRun));
+  if (!run) {
+    fprintf(stderr, "blobsharebench: out of memory\n");
+    return 1;
+  }
+  initBlobShare(&bs);
+
+  printf("%lu results, writer on CPU %d, reader on CPU %d, %ld CPUs online, latencies in ns\n",
+         operations, cpu[0], cpu[1], sysconf(_SC_NPROCESSORS_ONLN));
+  printf("%-14s %-8s %9s %7s %7s %7s %9s\n", "share", "side", "ops", "p50", "p99", "p99.9", "max");
+  for (k = 0; k < 2; k++) {
+    memset(run, 0, sizeof(TRun));
+    run->ops = &share_ops[k];
+    run->share = shares[k];
+    run->operations = operations;
+    run->cpu[0] = cpu[0];
+    run->cpu[1] = cpu[1];
+    if (runShare(run)) {
+      fprintf(stderr, "blobsharebench: cannot start the threads\n");
+      return 1;
+    }
+    printHist(run->ops->name, "publish", &run->hist[0]);
+    printHist(run->ops->name, "read", &run->hist[1]);
+    printf("%-14s %lu reads, %lu torn, %lu out of order; writer %s CPU %d, reader %s CPU %d\n", "",
+           run->reads, run->torn, run->backwards,
+           run->pinned[0] ? "pinned, ran on" : "not pinned, ended on", run->ranOn[0],
+           run->pinned[1] ? "pinned, ran on" : "not pinned, ended on", run->ranOn[1]);
+    ok = ok && run->torn == 0 && run->backwards == 0;
+  }
+  free(run);
+  return ok ? 0 : 1;
+}
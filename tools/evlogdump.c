@@ -0,0 +1,128 @@
+//======================================================================
+//
+// Decoder for the binary event log of event_log.c.  Prints all events in
+// time order as CSV on stdout and timing statistics on stderr: time spent
+// in each FSM state, sensor sampling intervals, blob and motor command
+// rates, and records lost.
+//
+// usage: evlogdump events.bin > events.csv
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "event_log.h"
+
+#define MAX_STATE EV_STATE_KD
+#define MAX_THREADS 256
+
+static const char *state_names[] = { "-", "OA", "SB", "AB", "FB", "RB", "KD" };
+static const char *motor_names[] = { "stop", "forward", "reverse", "spin-left", "spin-right" };
+
+static int cmpRecord(const void *a, const void *b) {
+    const TEventRecord *x = (const TEventRecord *)a, *y = (const TEventRecord *)b;
+    if (x->t != y->t) return x->t < y->t ? -1 : 1;
+    return x->thread != y->thread ? x->thread - y->thread : (x->seq < y->seq ? -1 : x->seq > y->seq);
+}
+
+static const char *stateName(int s) {
+    return s >= 0 && s <= MAX_STATE ? state_names[s] : "?";
+}
+
+int main(int argc, char *argv[]) {
+    TEventLogHeader hdr;
+    TEventRecord *rec, *e;
+    FILE *f;
+    uint64_t n, i, t0, gaps = 0;
+    uint32_t lastSeq[MAX_THREADS];
+    int seen[MAX_THREADS] = {0};
+    double stateTime[MAX_STATE + 1] = {0}, dt, dtMax = 0, dtSum = 0, span;
+    unsigned long stateEntries[MAX_STATE + 1] = {0}, nSensor = 0, nBlob = 0, nMotor = 0;
+    uint64_t stateSince = 0, lastSensor = 0;
+    int state = EV_STATE_NONE, s;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s events.bin > events.csv\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    f = fopen(argv[1], "rb");
+    if (f == NULL || fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        memcmp(hdr.magic, EVENT_LOG_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != EVENT_LOG_VERSION || hdr.recordSize != sizeof(TEventRecord)) {
+        fprintf(stderr, "%s: %s is not an event log of this version\n", argv[0], argv[1]);
+        return EXIT_FAILURE;
+    }
+    rec = (TEventRecord *)malloc((hdr.numRecords ? hdr.numRecords : 1) * sizeof(TEventRecord));
+    if (rec == NULL) return EXIT_FAILURE;
+    n = fread(rec, sizeof(TEventRecord), hdr.numRecords, f);
+    fclose(f);
+    if (n < hdr.numRecords) fprintf(stderr, "%s: log truncated after %llu records\n", argv[0], (unsigned long long)n);
+
+    // records are flushed per thread; gaps in a thread's numbers are lost records
+    for (i = 0; i < n; i++) {
+        e = &rec[i];
+        if (seen[e->thread] && e->seq != lastSeq[e->thread] + 1) gaps += e->seq - lastSeq[e->thread] - 1;
+        seen[e->thread] = 1;
+        lastSeq[e->thread] = e->seq;
+    }
+    qsort(rec, n, sizeof(TEventRecord), cmpRecord);
+    t0 = n ? rec[0].t : 0;
+
+    printf("t_ms,thread,seq,event,state,prev_state,ir_left,ir_right,us_cm,blob_size,blobnr,halign,action,speed,duration_ms,odo_speed,heading_mrad\n");
+    for (i = 0; i < n; i++) {
+        e = &rec[i];
+        printf("%.3f,%d,%u,", (e->t - t0) / 1e6, e->thread, e->seq);
+        switch (e->type) {
+            case EV_STATE:
+                printf("state,%s,%s,,,,,,,,,,,\n", stateName(e->arg0), stateName(e->arg1));
+                if (state != EV_STATE_NONE) stateTime[state] += (e->t - stateSince) / 1e9;
+                state = e->arg0 >= 0 && e->arg0 <= MAX_STATE ? e->arg0 : EV_STATE_NONE;
+                stateEntries[state]++;
+                stateSince = e->t;
+                break;
+            case EV_SENSOR:
+                printf("sensor,,,%d,%d,%d,,,,,,,%.3f,%d\n", e->arg0 & 1, (e->arg0 >> 1) & 1, e->arg1, e->val, e->arg2);
+                if (nSensor++ > 0) {
+                    dt = (e->t - lastSensor) / 1e6;
+                    dtSum += dt;
+                    if (dt > dtMax) dtMax = dt;
+                }
+                lastSensor = e->t;
+                break;
+            case EV_BLOB:
+                printf("blob,,,,,,%d,%d,%.4f,,,,,\n", e->arg1, e->arg2, e->val);
+                nBlob++;
+                break;
+            case EV_MOTOR:
+                printf("motor,,,,,,,,,%s,%d,%d,,\n",
+                       e->arg0 >= 0 && e->arg0 <= 4 ? motor_names[e->arg0] : "?", e->arg1, e->arg2);
+                nMotor++;
+                break;
+            default:
+                printf("unknown(%d),,,,,,,,,,,,,\n", e->type);
+                break;
+        }
+    }
+    if (n > 0 && state != EV_STATE_NONE) stateTime[state] += (rec[n - 1].t - stateSince) / 1e9;
+
+    span = n ? (rec[n - 1].t - t0) / 1e9 : 0;
+    fprintf(stderr, "%llu records over %.3f s, %llu dropped by the logger, %llu missing in sequence\n",
+            (unsigned long long)n, span, (unsigned long long)hdr.dropped, (unsigned long long)gaps);
+    fprintf(stderr, "state  entries   time(s)   share  mean dwell(ms)\n");
+    for (s = 1; s <= MAX_STATE; s++) {
+        fprintf(stderr, "%-5s  %7lu  %8.3f  %5.1f%%  %14.1f\n", state_names[s], stateEntries[s], stateTime[s],
+                span > 0 ? 100 * stateTime[s] / span : 0.0,
+                stateEntries[s] ? 1e3 * stateTime[s] / stateEntries[s] : 0.0);
+    }
+    fprintf(stderr, "sensor samples %lu, interval mean %.3f ms, max %.3f ms\n",
+            nSensor, nSensor > 1 ? dtSum / (nSensor - 1) : 0.0, dtMax);
+    fprintf(stderr, "blob results %lu (%.1f/s), motor commands %lu (%.1f/s)\n",
+            nBlob, span > 0 ? nBlob / span : 0.0, nMotor, span > 0 ? nMotor / span : 0.0);
+    free(rec);
+    return EXIT_SUCCESS;
+}
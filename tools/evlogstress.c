@@ -0,0 +1,64 @@
+//======================================================================
+//
+// Stress test of event_log.c on a disk that runs full.  Logs a number of
+// events in bursts (each burst fits into a ring, the pauses let the flush
+// thread drain them), closes the log and reads the header back: every
+// event must either be in the file or be counted as dropped, and the
+// file must hold exactly numRecords records.  Run it under a file size
+// limit or on a small filesystem, e.g. "make evlog-check", which allows
+// 3000 KiB: the first 2 MiB of the log fit, the rest must be dropped
+// without the process being killed (SIGXFSZ, SIGBUS).
+//
+// usage: evlogstress events.bin [events]
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "event_log.h"
+
+// Events per burst (below the ring length of event_log.c) and pause (us)
+#define BURST 3000
+#define PAUSE_US 60000
+
+int main(int argc, char *argv[]) {
+  TEventLogHeader hdr;
+  struct stat st;
+  long events, i;
+  FILE *f;
+  int ok;
+
+  events = argc > 2 ? atol(argv[2]) : 150000;
+  if (argc < 2 || events <= 0) {
+    fprintf(stderr, "usage: evlogstress events.bin [events]\n");
+    return 1;
+  }
+  if (openEventLog(argv[1])) {
+    fprintf(stderr, "evlogstress: cannot create %s\n", argv[1]);
+    return 1;
+  }
+  for (i = 0; i < events; i++) {
+    logEvent(EV_SENSOR, 0, (int)i, 0, 0);
+    if (i % BURST == BURST - 1) usleep(PAUSE_US);
+  }
+  closeEventLog();
+
+  f = fopen(argv[1], "rb");
+  if (f == NULL || fread(&hdr, sizeof(hdr), 1, f) != 1 || fstat(fileno(f), &st)) {
+    fprintf(stderr, "evlogstress: cannot read %s\n", argv[1]);
+    return 1;
+  }
+  fclose(f);
+  ok = hdr.numRecords + hdr.dropped == (uint64_t)events &&
+       (uint64_t)st.st_size == sizeof(hdr) + hdr.numRecords * sizeof(TEventRecord);
+  printf("%ld events logged: %llu in the file, %llu dropped, file %lld bytes: %s\n", events,
+         (unsigned long long)hdr.numRecords, (unsigned long long)hdr.dropped,
+         (long long)st.st_size, ok ? "ok" : "MISMATCH");
+  return !ok;
+}
@@ -0,0 +1,166 @@
+//======================================================================
+//
+// Benchmark of the obstacle-to-stop latency of the control loop of
+// camcar, with the motors and the IR sensors stubbed.  The car searches
+// for a blob all the time: every cycle that sees a new image (one every
+// CAM_FRAME_US) starts a spin pulse of PULSE_MS.  At a random time an
+// obstacle appears and stays; the latency is the time from then until
+// the motors stop for good.  The loop runs once as camcar did before
+// motor_sched.c, holding the control thread in delay() for every pulse,
+// and once with motor_sched.c, as camcar runs now.  Both see the same
+// obstacle times.
+//
+// usage: motorschedbench [trials]
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "motor_sched.h"
+#include "periodic.h"
+
+// Control loop period and image interval of camcar, search pulse
+#define CTRL_PERIOD_US 20000
+#define CAM_FRAME_US 33333
+#define PULSE_MS 200
+#define SEARCH_SPEED 50
+
+// The obstacle appears OBSTACLE_MIN_MS + 0..OBSTACLE_SPAN_MS into a trial,
+// which ends SETTLE_MS after it appeared
+#define OBSTACLE_MIN_MS 300
+#define OBSTACLE_SPAN_MS 500
+#define SETTLE_MS 300
+
+// Stubbed motors, called by the old loop and by the scheduler thread
+static pthread_mutex_t motor_lock = PTHREAD_MUTEX_INITIALIZER;
+static int moving;             // the motors run
+static long long stoppedAt;    // last time they went from running to stopped
+
+static long long start;        // start of the trial
+static long long obstacleAt;   // the IR sensors see the obstacle from then on
+
+static void setMotors(int speed) {
+  pthread_mutex_lock(&motor_lock);
+  if (moving && speed == 0) stoppedAt = monoTimeNs();
+  moving = speed != 0;
+  pthread_mutex_unlock(&motor_lock);
+}
+
+void initio_DriveForward(int8_t speed) { setMotors(speed); }
+void initio_DriveReverse(int8_t speed) { setMotors(speed); }
+void initio_SpinLeft(int8_t speed) { setMotors(speed); }
+void initio_SpinRight(int8_t speed) { setMotors(speed); }
+void setOdometryDirection(int left, int right) {}
+
+static int irObstacle(void) {
+  return monoTimeNs() >= obstacleAt;
+}
+
+// Number of the latest image of the camera
+static unsigned long newestImage(void) {
+  return (unsigned long)((monoTimeNs() - start) / (CAM_FRAME_US * 1000LL));
+}
+
+// The search of camcar before motor_sched.c: the pulse blocks the loop
+static void delayLoop(void) {
+  TPeriodic per;
+  unsigned long blobnr = 0, newnr;
+
+  initPeriodic(&per, CTRL_PERIOD_US);
+  while (monoTimeNs() < obstacleAt + SETTLE_MS * 1000000LL) {
+    waitPeriod(&per);
+    newnr = newestImage();
+    if (irObstacle()) {
+      initio_DriveForward(0);
+    } else if (blobnr < newnr) {
+      initio_SpinLeft(SEARCH_SPEED);
+      usleep(PULSE_MS * 1000);  // delay() of wiringPi
+      initio_DriveForward(0);
+      blobnr = newnr;
+    }
+  }
+}
+
+// The search of camcar now: the scheduler ends the pulse
+static void schedLoop(TMotorSched *ms) {
+  TPeriodic per;
+  unsigned long blobnr = 0, newnr;
+
+  initPeriodic(&per, CTRL_PERIOD_US);
+  while (monoTimeNs() < obstacleAt + SETTLE_MS * 1000000LL) {
+    waitPeriod(&per);
+    newnr = newestImage();
+    if (motorBusy(ms)) blobnr = newnr;
+    if (irObstacle()) {
+      motorStop(ms);
+    } else if (blobnr < newnr) {
+      motorPulse(ms, MOTOR_SPIN_LEFT, SEARCH_SPEED, PULSE_MS);
+      blobnr = newnr;
+    }
+  }
+}
+
+// Runs one trial, returns the latency in ms, or -1 if the motors still run
+static double runTrial(TMotorSched *ms) {
+  double lat;
+
+  start = monoTimeNs();
+  obstacleAt = start + (OBSTACLE_MIN_MS + rand() % OBSTACLE_SPAN_MS) * 1000000LL;
+  if (ms) schedLoop(ms);
+  else delayLoop();
+  pthread_mutex_lock(&motor_lock);
+  lat = moving ? -1 : stoppedAt > obstacleAt ? (stoppedAt - obstacleAt) / 1e6 : 0;
+  pthread_mutex_unlock(&motor_lock);
+  return lat;
+}
+
+static int cmpDouble(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+  static const char *names[2] = { "delay() loop", "motor_sched" };
+  int trials = argc > 1 ? atoi(argv[1]) : 40;
+  TMotorSched *ms = NULL;
+  double *lat, sum;
+  int m, k, ok = 1;
+
+  lat = (double *)malloc((trials > 0 ? trials : 1) * sizeof(double));
+  if (lat == NULL || trials <= 0) {
+    fprintf(stderr, "usage: motorschedbench [trials]\n");
+    return 1;
+  }
+  printf("%d trials, control period %d ms, pulse %d ms, obstacle-to-stop latency in ms\n",
+         trials, CTRL_PERIOD_US / 1000, PULSE_MS);
+  printf("%-14s %7s %7s %7s %7s\n", "loop", "mean", "p50", "p90", "max");
+  for (m = 0; m < 2; m++) {
+    if (m == 1 && (ms = startMotorSched()) == NULL) {
+      fprintf(stderr, "motorschedbench: cannot start the scheduler\n");
+      return 1;
+    }
+    srand(1);
+    for (k = 0, sum = 0; k < trials; k++) {
+      lat[k] = runTrial(ms);
+      if (lat[k] < 0) {
+        fprintf(stderr, "motorschedbench: %s: motors still run at the end of trial %d\n", names[m], k);
+        ok = 0;
+      }
+      sum += lat[k];
+    }
+    qsort(lat, trials, sizeof(double), cmpDouble);
+    printf("%-14s %7.1f %7.1f %7.1f %7.1f\n", names[m], sum / trials, lat[trials / 2],
+           lat[trials * 9 / 10], lat[trials - 1]);
+  }
+  stopMotorSched(ms);
+  free(lat);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#include "triple_buf.h"
+
+// Flag in middle: the shared slot holds a value the reader has not taken yet.
+#define TRIPLE_BUF_FRESH 4
+
+// Function to reset the slot indices.
+void initTripleBuf(TTripleBuf *tb) {
+    tb->back = 0;
+    tb->middle = 1;
+    tb->front = 2;
+}
+
+// Function to publish the back slot (writer thread only).
+int publishTripleBuf(TTripleBuf *tb) {
+    int old;
+
+    // release: the slot contents are visible before the reader can pick it up
+    old = __atomic_exchange_n(&tb->middle, tb->back | TRIPLE_BUF_FRESH, __ATOMIC_ACQ_REL);
+    tb->back = old & ~TRIPLE_BUF_FRESH;
+    return tb->back;
+}
+
+// Function to take the newest slot (reader thread only).
+int readTripleBuf(TTripleBuf *tb, int *fresh) {
+    int old, got = 0;
+
+    if (__atomic_load_n(&tb->middle, __ATOMIC_RELAXED) & TRIPLE_BUF_FRESH) {
+        // acquire: pairs with the writer's exchange
+        old = __atomic_exchange_n(&tb->middle, tb->front, __ATOMIC_ACQ_REL);
+        tb->front = old & ~TRIPLE_BUF_FRESH;
+        got = 1;
+    }
+    if (fresh) *fresh = got;
+    return tb->front;
+}
@@ -0,0 +1,46 @@
+#ifndef _TRIPLE_BUF_H_
+#define _TRIPLE_BUF_H_
+//======================================================================
+//
+// Module that hands the latest of a series of values from one writer
+// thread to one reader thread without a lock.  The caller keeps three
+// slots of its own type; this module only exchanges their indices.  The
+// writer fills its private slot and swaps it with the shared middle
+// slot, the reader swaps the middle slot with its own one when it holds
+// a newer value.  Both sides are wait-free and neither ever sees a
+// half-written value.  There must be exactly one writer thread and one
+// reader thread.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+// Slot indices (initialise with initTripleBuf())
+typedef struct TripleBuf {
+  int back;                 // writer only: slot being filled
+  int front;                // reader only: slot being read
+  int middle __attribute__((aligned(64)));  // shared slot index | TRIPLE_BUF_FRESH
+} TTripleBuf;
+
+
+//======================================================================
+// initTripleBuf():
+// Give the writer slot 0 and the reader slot 2, with nothing published.
+void initTripleBuf(TTripleBuf *tb);
+
+// publishTripleBuf():
+// Writer side: publish the filled slot tb->back.  Returns the slot to fill
+// next (the new tb->back).
+int publishTripleBuf(TTripleBuf *tb);
+
+// readTripleBuf():
+// Reader side: take the newest published slot, if there is one the reader
+// has not taken yet.  Returns the slot to read (tb->front), which stays the
+// same until a newer value is published.  *fresh (unless NULL) is set to 1
+// if a newer slot was taken, to 0 otherwise.
+int readTripleBuf(TTripleBuf *tb, int *fresh);
+
+
+#endif /* _TRIPLE_BUF_H_ */
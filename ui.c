@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <curses.h>
+#include <pthread.h>
+#include <sched.h>
+#include "ui.h"
+#include "event_log.h"
+#include "triple_buf.h"
+
+struct Ui {
+    const char *title;
+    TPipeline *pipe;
+    unsigned long cpus;
+    TCarStatus status[3];     // status snapshots, handed over through slots
+    TTripleBuf slots;         // control thread writes, render thread reads
+    int haveStatus;           // render thread only: a status was received
+    int key;                  // last key pressed (render thread only)
+    int quit;                 // 'q' pressed
+    int stop;                 // stopUi() called
+    pthread_t thread;
+};
+
+// Helper function to show throughput and queue depth of each pipeline stage.
+static void showPipelineStats(TPipeline *pl) {
+    static const char *names[PIPE_STAGES] = {"capture", "decode", "detect"};
+    TPipeStats st;
+    int s;
+
+    getPipelineStats(pl, &st);
+    for (s = 0; s < PIPE_STAGES; s++) {
+        mvprintw(11 + s, 1, "Pipeline %-7s: %5.1f fps, busy %3.0f%%, dropped %lu, queue %d (max %d)",
+                 names[s], st.stage[s].frames / st.elapsed, 100.0 * st.stage[s].busy / st.elapsed,
+                 st.stage[s].dropped, st.stage[s].depth, st.stage[s].maxDepth);
+        clrtoeol();
+    }
+}
+
+// Helper function to show the real-time mode and the timing statistics of the control loop.
+static void showPeriodicStats(const TCarStatus *cs) {
+    const TPeriodicStats *st = &cs->timing;
+    unsigned long n = st->cycles ? st->cycles : 1;
+
+    mvprintw(15, 1, "Control: period %lld us, %s%s%s, cycles %lu, missed %lu",
+             cs->period / 1000, (cs->rtFlags & RT_FIFO) ? "SCHED_FIFO" : "SCHED_OTHER (degraded)",
+             (cs->rtFlags & RT_PINNED) ? ", pinned" : "", (cs->rtFlags & RT_LOCKED) ? ", mlocked" : "",
+             st->cycles, st->missed);
+    clrtoeol();
+    mvprintw(16, 1, "Control: wake-up latency %lld/%lld/%lld us, exec %lld/%lld/%lld us (min/avg/max)",
+             st->latMin / 1000, st->latSum / n / 1000, st->latMax / 1000,
+             st->execMin / 1000, st->execSum / n / 1000, st->execMax / 1000);
+    clrtoeol();
+}
+
+// Helper function to show the FSM state and the blob status.
+static void showStatus(const TCarStatus *cs) {
+    switch (cs->state) {
+        case EV_STATE_OA:
+            mvprintw(3, 1, "State OA (stop to avoid obstacle), o-left=%d, o-right=%d", cs->obstacleL, cs->obstacleR);
+            break;
+        case EV_STATE_SB:
+            mvprintw(3, 1, "State SB (search blob), blob.size=%d (blobnr: %lu)", cs->blobSize, cs->blobnr);
+            break;
+        case EV_STATE_AB:
+            mvprintw(3, 1, "State AB (align towards blob), blob.size=%d, halign=%f", cs->blobSize, cs->halign);
+            break;
+        case EV_STATE_FB:
+            mvprintw(3, 1, "State FB (drive forward), dist=%d", cs->distance);
+            break;
+        case EV_STATE_RB:
+            mvprintw(3, 1, "State RB (drive backwards), dist=%d", cs->distance);
+            break;
+        case EV_STATE_KD:
+            mvprintw(3, 1, "State KD (keep distance), dist=%d", cs->distance);
+            break;
+        default:
+            mvprintw(3, 1, "State -");
+            break;
+    }
+    clrtoeol();
+    mvprintw(10, 1, "Status: blob(size=%d, halign=%f, blobnr=%lu)", cs->blobSize, cs->halign, cs->blobnr);
+    clrtoeol();
+    mvprintw(4, 1, "Track: halign=%f, conf=%.2f", cs->trackHalign, cs->trackConf);
+    clrtoeol();
+    if (cs->odoMode) {
+        mvprintw(5, 1, "Odometry (%s): x=%.2f m, y=%.2f m, heading=%.0f deg, speed=%.2f m/s, ticks=%lu/%lu",
+                 cs->odoMode == ODO_ISR ? "isr" : "polled", cs->odo.x, cs->odo.y, cs->odo.heading * 180 / M_PI,
+                 cs->odo.speed, cs->odo.ticksL, cs->odo.ticksR);
+        clrtoeol();
+    }
+    showPeriodicStats(cs);
+}
+
+// Render thread: redraws at UI_RATE and reads the keyboard.
+static void *renderThread(void *arg) {
+    TUi *ui = (TUi *)arg;
+    TPeriodic per;
+    int ch, front, fresh;
+
+    setThreadRealtime(pthread_self(), 0, ui->cpus);
+    initPeriodic(&per, 1000000L / UI_RATE);
+    while (!__atomic_load_n(&ui->stop, __ATOMIC_ACQUIRE)) {
+        waitPeriod(&per);
+
+        front = readTripleBuf(&ui->slots, &fresh);
+        if (fresh) ui->haveStatus = 1;
+
+        while ((ch = getch()) != ERR) {
+            ui->key = ch;
+            if (ch == 'q') __atomic_store_n(&ui->quit, 1, __ATOMIC_RELEASE);
+        }
+
+        mvprintw(1, 1, "%s: Press 'q' to end program", ui->title);
+        if (ui->key) mvprintw(2, 1, "Key code: '%c' (%d)", ui->key, ui->key);
+        if (ui->haveStatus) showStatus(&ui->status[front]);
+        if (ui->pipe) showPipelineStats(ui->pipe);
+        refresh();
+    }
+    return NULL;
+}
+
+// Function to set up curses and start the render thread.
+TUi *startUi(const char *title, TPipeline *pl, unsigned long cpus) {
+    TUi *ui = (TUi *)calloc(1, sizeof(TUi));
+    pthread_attr_t attr;
+    struct sched_param param;
+    WINDOW *mainwin;
+    int res;
+
+    if (ui == NULL) return NULL;
+    ui->title = title;
+    ui->pipe = pl;
+    ui->cpus = cpus;
+    initTripleBuf(&ui->slots);
+
+    mainwin = initscr();  // Initialize curses library
+    noecho();
+    cbreak();
+    nodelay(mainwin, TRUE);
+    keypad(mainwin, TRUE);
+
+    // normal priority, whatever the policy of the calling thread
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    memset(&param, 0, sizeof(param));
+    pthread_attr_setschedparam(&attr, &param);
+    res = pthread_create(&ui->thread, &attr, renderThread, ui);
+    pthread_attr_destroy(&attr);
+    if (res) {
+        endwin();
+        free(ui);
+        return NULL;
+    }
+    return ui;
+}
+
+// Function to publish a status snapshot (control thread).
+void publishUiStatus(TUi *ui, const TCarStatus *st) {
+    ui->status[ui->slots.back] = *st;
+    publishTripleBuf(&ui->slots);
+}
+
+// Function to check for the quit key.
+int uiQuit(TUi *ui) {
+    return __atomic_load_n(&ui->quit, __ATOMIC_ACQUIRE);
+}
+
+// Function to stop the display.
+void stopUi(TUi *ui) {
+    __atomic_store_n(&ui->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(ui->thread, NULL);
+    endwin();  // Cleanup curses library
+    free(ui);
+}
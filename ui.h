@@ -0,0 +1,65 @@
+#ifndef _UI_H_
+#define _UI_H_
+//======================================================================
+//
+// Module for the curses display of camcar.  All terminal I/O happens in
+// a render thread with normal (non real-time) priority that redraws at a
+// fixed rate from the latest status snapshot.  The control loop only
+// copies its status into a triple buffer (no lock, no terminal I/O) and
+// polls a flag for the quit key.
+//
+// license: GNU LESSER GENERAL PUBLIC LICENSE
+//          Version 2.1, February 1999
+//          (for details see LICENSE file)
+//
+//======================================================================
+
+#include "pipeline.h"
+#include "periodic.h"
+#include "odometry.h"
+
+// Redraw rate of the render thread (Hz)
+#define UI_RATE 10
+
+// Status of the control loop shown by the display
+typedef struct CarStatus {
+  int state;                // FSM state (EV_STATE_* of event_log.h)
+  int obstacleL, obstacleR; // IR obstacle sensors
+  int distance;             // ultrasonic distance in cm, -1 if not measured
+  int blobSize;
+  double halign;
+  unsigned long blobnr;     // number of the latest blob result
+  double trackHalign;       // predicted alignment of the tracked blob
+  double trackConf;         // confidence of the track (0..1)
+  long long period;         // control period (ns)
+  int rtFlags;              // real-time setup of the control thread (RT_*)
+  TPeriodicStats timing;    // timing statistics of the control loop
+  TOdometry odo;            // wheel odometry
+  int odoMode;              // source of the wheel edges (ODO_*), 0 if none
+} TCarStatus;
+
+// Handle of a running display
+typedef struct Ui TUi;
+
+
+//======================================================================
+// startUi():
+// Initialise curses and start the render thread, pinned to the CPUs in
+// cpus (0: no pinning).  title is shown in the first line and the pipeline
+// statistics of pl (may be NULL) below the status.  Returns NULL on failure.
+TUi *startUi(const char *title, TPipeline *pl, unsigned long cpus);
+
+// publishUiStatus():
+// Hand the current status to the display (control thread only, never blocks).
+void publishUiStatus(TUi *ui, const TCarStatus *st);
+
+// uiQuit():
+// Returns non-zero once 'q' was pressed.
+int uiQuit(TUi *ui);
+
+// stopUi():
+// Stop the render thread and restore the terminal.
+void stopUi(TUi *ui);
+
+
+#endif /* _UI_H_ */